@@ -0,0 +1,127 @@
+// OBJ import, Assimp with the flags Model uses against ObjReader.
+// Usage: obj_reader_benchmark [file.obj ...] [--synthetic triangles] [--iterations n]
+// Without files it reads assets/indoor/trice.obj and a generated grid of 10M triangles.
+
+#include "../src/ObjReader.h"
+
+#include "assimp/Importer.hpp"
+#include "assimp/scene.h"
+#include "assimp/postprocess.h"
+
+#include <cmath>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+
+namespace {
+    // keep in sync with Model.cpp
+    const unsigned int importFlags = aiProcess_Triangulate |
+                                     aiProcess_JoinIdenticalVertices |
+                                     aiProcess_GenNormals |
+                                     aiProcess_FlipUVs |
+                                     aiProcess_CalcTangentSpace;
+
+    // a wavy square grid with uvs and normals, two triangles per quad
+    bool writeSynthetic(const std::string &path, size_t triangles) {
+        size_t side = std::max((size_t) std::sqrt((double) triangles / 2.0), (size_t) 1);
+        FILE *file = fopen(path.c_str(), "wb");
+        if (!file)
+            return false;
+        std::vector<char> buffer(1 << 20);
+        setvbuf(file, buffer.data(), _IOFBF, buffer.size());
+        fprintf(file, "# synthetic grid, %zu triangles\no grid\n", side * side * 2);
+        for (size_t y = 0; y <= side; y++) {
+            for (size_t x = 0; x <= side; x++) {
+                float u = (float) x / side, v = (float) y / side;
+                fprintf(file, "v %.6f %.6f %.6f\n", u * 100.0f, std::sin(u * 20.0f) * std::cos(v * 20.0f), v * 100.0f);
+            }
+        }
+        for (size_t y = 0; y <= side; y++)
+            for (size_t x = 0; x <= side; x++)
+                fprintf(file, "vt %.6f %.6f\n", (float) x / side, (float) y / side);
+        for (size_t y = 0; y <= side; y++)
+            for (size_t x = 0; x <= side; x++)
+                fprintf(file, "vn 0 1 0\n");
+        for (size_t y = 0; y < side; y++) {
+            for (size_t x = 0; x < side; x++) {
+                size_t a = y * (side + 1) + x + 1, b = a + 1, c = a + side + 1, d = c + 1;
+                fprintf(file, "f %zu/%zu/%zu %zu/%zu/%zu %zu/%zu/%zu\n", a, a, a, c, c, c, b, b, b);
+                fprintf(file, "f %zu/%zu/%zu %zu/%zu/%zu %zu/%zu/%zu\n", b, b, b, c, c, c, d, d, d);
+            }
+        }
+        return fclose(file) == 0;
+    }
+
+    template<typename Body>
+    double bestOf(int iterations, Body body) {
+        double best = 1e30;
+        for (int i = 0; i < iterations; i++) {
+            auto start = std::chrono::steady_clock::now();
+            body();
+            std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+            best = std::min(best, elapsed.count());
+        }
+        return best;
+    }
+
+    void compare(const std::string &path, int iterations) {
+        std::ifstream in(path, std::ios::binary | std::ios::ate);
+        double megabytes = (double) in.tellg() / (1024.0 * 1024.0);
+
+        size_t objTriangles = 0;
+        double obj = bestOf(iterations, [&]() {
+            ObjReader reader;
+            reader.read(path);
+            objTriangles = reader.triangleCount();
+        });
+        size_t assimpTriangles = 0;
+        double assimp = bestOf(iterations, [&]() {
+            Assimp::Importer importer;
+            const aiScene *scene = importer.ReadFile(path.c_str(), importFlags);
+            assimpTriangles = 0;
+            for (unsigned int i = 0; scene && i < scene->mNumMeshes; i++)
+                assimpTriangles += scene->mMeshes[i]->mNumFaces;
+        });
+
+        std::cout << path << " " << megabytes << " MB, best of " << iterations << "\n"
+                  << "  Assimp:    " << assimp << " ms, " << assimpTriangles << " triangles, "
+                  << megabytes / assimp * 1000.0 << " MB/s\n"
+                  << "  ObjReader: " << obj << " ms, " << objTriangles << " triangles, "
+                  << megabytes / obj * 1000.0 << " MB/s\n"
+                  << "  speedup:   " << assimp / obj << "x" << std::endl;
+    }
+}
+
+int main(int argc, char **argv) {
+    std::vector<std::string> files;
+    size_t synthetic = 10000000;
+    int iterations = 3;
+    for (int i = 1; i < argc; i++) {
+        std::string argument = argv[i];
+        if (argument == "--synthetic" && i + 1 < argc)
+            synthetic = std::strtoull(argv[++i], nullptr, 10);
+        else if (argument == "--iterations" && i + 1 < argc)
+            iterations = std::max(std::atoi(argv[++i]), 1);
+        else
+            files.push_back(argument);
+    }
+
+    if (files.empty()) {
+        files.push_back("assets/indoor/trice.obj");
+        std::string path = "obj_reader_synthetic.obj";
+        std::cout << "Writing " << path << std::endl;
+        if (!writeSynthetic(path, synthetic)) {
+            std::cout << "Failed to write " << path << std::endl;
+            return 1;
+        }
+        files.push_back(path);
+    }
+    for (auto &file: files)
+        compare(file, iterations);
+    return 0;
+}
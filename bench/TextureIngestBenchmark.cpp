@@ -0,0 +1,107 @@
+// Texture ingest, the decode + memcpy + per byte flip Texture::loadImg used to do against
+// Texture::decodeFlipped from a mapped file into a preallocated buffer standing in for the unpack buffer.
+// CPU only, no GL context is created. Usage: texture_ingest_benchmark <image> [iterations]
+
+#include "../src/Texture.h"
+#include "../src/MappedFile.h"
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <iostream>
+#include <algorithm>
+
+namespace {
+    // the previous Texture::loadImg, kept verbatim as the baseline
+    unsigned char *loadReference(const std::string &path, int &width, int &height) {
+        int components;
+        stbi_uc *data = stbi_load(path.c_str(), &width, &height, &components, 4);
+        if (!data)
+            return nullptr;
+        size_t dataSize = width * height * 4 * sizeof(unsigned char);
+        auto *result = new unsigned char[dataSize];
+        memcpy(result, data, dataSize);
+        size_t columns = (size_t) width, rows = (size_t) height;
+        for (size_t i = 0; i < columns; ++i) {
+            for (size_t j = 0; j < rows / 2; ++j) {
+                for (size_t k = 0; k < 4; ++k) {
+                    size_t coord1 = (j * columns + i) * 4 + k;
+                    size_t coord2 = ((rows - j - 1) * columns + i) * 4 + k;
+                    std::swap(result[coord1], result[coord2]);
+                }
+            }
+        }
+        stbi_image_free(data);
+        return result;
+    }
+
+    template<typename Body>
+    double bestOf(int iterations, Body body) {
+        double best = 1e30;
+        for (int i = 0; i < iterations; i++) {
+            auto start = std::chrono::steady_clock::now();
+            body();
+            std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+            best = std::min(best, elapsed.count());
+        }
+        return best;
+    }
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        std::cout << "Usage: texture_ingest_benchmark <image> [iterations]" << std::endl;
+        return 1;
+    }
+    std::string path = argv[1];
+    int iterations = argc > 2 ? std::max(std::atoi(argv[2]), 1) : 10;
+
+    int width = 0, height = 0;
+    unsigned char *reference = loadReference(path, width, height);
+    if (!reference) {
+        std::cout << "Failed to load " << path << std::endl;
+        return 1;
+    }
+    std::vector<unsigned char> destination((size_t) width * height * 4);
+    MappedFile file(path);
+    if (!Texture::decodeFlipped(file.data(), file.size(), width, height, destination.data()) ||
+        memcmp(reference, destination.data(), destination.size()) != 0) {
+        std::cout << "Mismatch between the two paths" << std::endl;
+        return 1;
+    }
+    delete[] reference;
+
+    double before = bestOf(iterations, [&]() {
+        int w, h;
+        delete[] loadReference(path, w, h);
+    });
+    double after = bestOf(iterations, [&]() {
+        MappedFile mapped(path);
+        int w, h;
+        Texture::imageSize(mapped.data(), mapped.size(), w, h);
+        Texture::decodeFlipped(mapped.data(), mapped.size(), w, h, destination.data());
+    });
+    // the flip on its own, the part that is not stb_image decoding
+    std::vector<unsigned char> decoded(destination);
+    size_t columns = (size_t) width, rows = (size_t) height;
+    double flipBefore = bestOf(iterations, [&]() {
+        for (size_t i = 0; i < columns; ++i)
+            for (size_t j = 0; j < rows / 2; ++j)
+                for (size_t k = 0; k < 4; ++k)
+                    std::swap(decoded[(j * columns + i) * 4 + k], decoded[((rows - j - 1) * columns + i) * 4 + k]);
+    });
+    double flipAfter = bestOf(iterations, [&]() {
+        size_t rowSize = (size_t) width * 4;
+        for (int row = 0; row < height; row++)
+            memcpy(destination.data() + (size_t) (height - row - 1) * rowSize, decoded.data() + row * rowSize, rowSize);
+    });
+
+    std::cout << path << " " << width << "x" << height << ", best of " << iterations << "\n"
+              << "  load:  " << before << " ms -> " << after << " ms\n"
+              << "  flip:  " << flipBefore << " ms -> " << flipAfter << " ms" << std::endl;
+    return 0;
+}
@@ -0,0 +1,186 @@
+// Uniform setting, one frame's worth of the calls draw() makes for the forward and G buffer passes, three ways:
+// glGetUniformLocation with a std::string per call (what the Shader setters used to do), the setters on the
+// reflected location table, and pre-resolved UniformHandles. Only CPU time is measured, nothing is drawn.
+// The last two compare against the program's shadow copies, after the first frame only the values that change
+// between materials are sent, the skipped count is printed with the results.
+// Needs a GL 4.5 context, a hidden window is created. Run from the build's bin directory so shader/ resolves.
+// Usage: uniform_benchmark [meshes per pass] [frames]
+
+#include "../src/Shader.h"
+
+#include "GLFW/glfw3.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <iostream>
+#include <algorithm>
+
+namespace {
+    const char *const configNames[] = {"config.blinnPhong", "config.directionalLightShadow", "config.bloom",
+                                       "config.deferredShading", "config.normalMapping", "config.NPR",
+                                       "config.areaLight", "config.SSAO", "isLightObject"};
+    const int configCount = sizeof(configNames) / sizeof(configNames[0]);
+
+    struct Material {
+        bool hasTexture;
+        glm::vec3 ambient, diffuse, specular;
+        float shininess;
+    };
+
+    // the Shader setters before the location table
+    struct LookupEveryCall {
+        GLuint program;
+
+        void setBool(const std::string &name, bool value) const {
+            glUniform1i(glGetUniformLocation(program, name.c_str()), (int) value);
+        }
+        void setFloat(const std::string &name, float value) const {
+            glUniform1f(glGetUniformLocation(program, name.c_str()), value);
+        }
+        void setVec3(const std::string &name, const glm::vec3 &value) const {
+            glUniform3fv(glGetUniformLocation(program, name.c_str()), 1, &value[0]);
+        }
+        void setMat4(const std::string &name, const glm::mat4 &value) const {
+            glUniformMatrix4fv(glGetUniformLocation(program, name.c_str()), 1, GL_FALSE, glm::value_ptr(value));
+        }
+    };
+
+    template<class Setter>
+    void frameByName(const Setter &setter, const std::vector<Material> &materials, const glm::mat4 &matrix) {
+        for (int i = 0; i < configCount; i++)
+            setter.setBool(configNames[i], (i & 1) != 0);
+        setter.setMat4("model", matrix);
+        setter.setMat4("view", matrix);
+        setter.setMat4("projection", matrix);
+        for (int i = 0; i < 6; i++)
+            setter.setMat4("shadowMatrices[" + std::to_string(i) + "]", matrix);
+        for (int pass = 0; pass < 2; pass++) {
+            for (auto &material: materials) {
+                setter.setBool("hasTexture", material.hasTexture);
+                setter.setBool("hasNormalMap", false);
+                setter.setVec3("material.ambient", material.ambient);
+                setter.setVec3("material.diffuse", material.diffuse);
+                setter.setVec3("material.specular", material.specular);
+                setter.setFloat("material.shininess", material.shininess);
+            }
+        }
+    }
+
+    struct Handles {
+        UniformHandle<bool> config[configCount];
+        UniformHandle<glm::mat4> model, view, projection, shadowMatrices[6];
+        UniformHandle<bool> hasTexture, hasNormalMap;
+        UniformHandle<glm::vec3> ambient, diffuse, specular;
+        UniformHandle<float> shininess;
+
+        explicit Handles(const Shader &shader) {
+            for (int i = 0; i < configCount; i++)
+                config[i] = shader.uniform<bool>(configNames[i]);
+            model = shader.uniform<glm::mat4>("model");
+            view = shader.uniform<glm::mat4>("view");
+            projection = shader.uniform<glm::mat4>("projection");
+            for (int i = 0; i < 6; i++)
+                shadowMatrices[i] = shader.uniform<glm::mat4>("shadowMatrices[" + std::to_string(i) + "]");
+            hasTexture = shader.uniform<bool>("hasTexture");
+            hasNormalMap = shader.uniform<bool>("hasNormalMap");
+            ambient = shader.uniform<glm::vec3>("material.ambient");
+            diffuse = shader.uniform<glm::vec3>("material.diffuse");
+            specular = shader.uniform<glm::vec3>("material.specular");
+            shininess = shader.uniform<float>("material.shininess");
+        }
+    };
+
+    void frameByHandle(const Handles &handles, const std::vector<Material> &materials, const glm::mat4 &matrix) {
+        for (int i = 0; i < configCount; i++)
+            handles.config[i].set((i & 1) != 0);
+        handles.model.set(matrix);
+        handles.view.set(matrix);
+        handles.projection.set(matrix);
+        for (auto &shadowMatrix: handles.shadowMatrices)
+            shadowMatrix.set(matrix);
+        for (int pass = 0; pass < 2; pass++) {
+            for (auto &material: materials) {
+                handles.hasTexture.set(material.hasTexture);
+                handles.hasNormalMap.set(false);
+                handles.ambient.set(material.ambient);
+                handles.diffuse.set(material.diffuse);
+                handles.specular.set(material.specular);
+                handles.shininess.set(material.shininess);
+            }
+        }
+    }
+
+    // microseconds per frame, best of five runs
+    template<typename Body>
+    double perFrame(int frames, Body body) {
+        double best = 1e30;
+        for (int run = 0; run < 5; run++) {
+            auto start = std::chrono::steady_clock::now();
+            for (int frame = 0; frame < frames; frame++)
+                body();
+            std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+            best = std::min(best, elapsed.count() / frames);
+        }
+        return best;
+    }
+}
+
+int main(int argc, char **argv) {
+    int meshes = argc > 1 ? std::max(std::atoi(argv[1]), 1) : 64;
+    int frames = argc > 2 ? std::max(std::atoi(argv[2]), 1) : 1000;
+
+    if (!glfwInit())
+        return 1;
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 5);
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    GLFWwindow *window = glfwCreateWindow(64, 64, "uniform_benchmark", nullptr, nullptr);
+    if (!window) {
+        glfwTerminate();
+        return 1;
+    }
+    glfwMakeContextCurrent(window);
+    if (glewInit() != GLEW_OK) {
+        glfwTerminate();
+        return 1;
+    }
+
+    {
+        // the forward shader has every uniform of the workload except shadowMatrices and the config flags, which
+        // texture.frag compiles in as permutations, those then cost a miss
+        Shader shader("shader/texture.vert", "shader/texture.frag");
+        shader.finish();
+        shader.use();
+        GLint program = 0;
+        glGetIntegerv(GL_CURRENT_PROGRAM, &program);
+
+        std::vector<Material> materials((size_t) meshes);
+        for (int i = 0; i < meshes; i++)
+            materials[i] = Material{i % 3 != 0, glm::vec3(0.1f * (float) (i % 10)), glm::vec3(0.5f), glm::vec3(0.2f),
+                                    32.0f};
+        glm::mat4 matrix(1.0f);
+
+        LookupEveryCall lookup{(GLuint) program};
+        Handles handles(shader);
+        double before = perFrame(frames, [&]() { frameByName(lookup, materials, matrix); });
+        Shader::uniformStats() = UniformStats();
+        double table = perFrame(frames, [&]() { frameByName(shader, materials, matrix); });
+        double after = perFrame(frames, [&]() { frameByHandle(handles, materials, matrix); });
+        glFinish();
+
+        int calls = configCount + 3 + 6 + 2 * 6 * meshes;
+        std::cout << meshes << " meshes per pass, " << calls << " uniforms per frame, best of 5 x " << frames
+                  << " frames\n"
+                  << "  glGetUniformLocation per call: " << before << " us/frame\n"
+                  << "  location table by name:        " << table << " us/frame\n"
+                  << "  UniformHandle:                 " << after << " us/frame\n"
+                  << "  shadowed writes: " << Shader::uniformStats().issued << " sent, "
+                  << Shader::uniformStats().skipped << " skipped" << std::endl;
+    }
+
+    glfwDestroyWindow(window);
+    glfwTerminate();
+    return 0;
+}
@@ -17,16 +17,33 @@ uniform mat4 projection;
 uniform mat4 view;
 uniform mat4 model;
 
+// Model::VertexFormat::Compact, position is unorm16 in the model bounds, normal and tangent are octahedral
+uniform bool compactVertices = false;
+uniform vec3 positionScale = vec3(1.0);
+uniform vec3 positionOffset = vec3(0.0);
+
+vec3 octahedralDecode(vec2 e)
+{
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+    return normalize(n);
+}
+
 void main(void)
 {
+    vec3 objectPosition = position * positionScale + positionOffset;
+    vec3 objectNormal = compactVertices ? octahedralDecode(normal.xy) : normal;
+    vec3 objectTangent = compactVertices ? octahedralDecode(tangent.xy) : tangent;
+
     mat4 mv_matrix = view * model; 
-    gl_Position = projection * mv_matrix * vec4(position, 1.0);
-    vs_out.ws_coords = (model * vec4(position, 1.0)).xyz;
-    vs_out.normal = mat3(transpose(inverse(model))) * normal;
+    gl_Position = projection * mv_matrix * vec4(objectPosition, 1.0);
+    vs_out.ws_coords = (model * vec4(objectPosition, 1.0)).xyz;
+    vs_out.normal = mat3(transpose(inverse(model))) * objectNormal;
     // vs_out.normal = normal; 
-    vs_out.tangent = tangent;
-    vec3 T = normalize(vec3(model * vec4(tangent, 0.0)));
-    vec3 N = normalize(vec3(model * vec4(normal, 0.0)));
+    vs_out.tangent = objectTangent;
+    vec3 T = normalize(vec3(model * vec4(objectTangent, 0.0)));
+    vec3 N = normalize(vec3(model * vec4(objectNormal, 0.0)));
     // T = normalize(T - dot(T, N) * N);
     vec3 B = normalize(cross(N, T));
     vs_out.TBN = mat3(T, B, N);
@@ -46,8 +46,9 @@ void main(void)
     if (hasNormalMap)
     {
         vec3 normalizedNormal;
-        normalizedNormal = texture(NormalMap, fs_in.texcoord0).xyz;
-        normalizedNormal = normalizedNormal * 2.0 - vec3(1.0);   
+        // two channel BC5, z is rebuilt from the unit length
+        normalizedNormal.xy = texture(NormalMap, fs_in.texcoord0).xy * 2.0 - vec2(1.0);
+        normalizedNormal.z = sqrt(max(1.0 - dot(normalizedNormal.xy, normalizedNormal.xy), 0.0));
         normalizedNormal = normalize(fs_in.TBN * normalizedNormal);
         nm = normalizedNormal;
     }
@@ -3,7 +3,12 @@ layout (location = 0) in vec3 aPos;
 
 uniform mat4 model;
 
+// Model::VertexFormat::Compact, position is unorm16 in the model bounds
+uniform vec3 positionScale = vec3(1.0);
+uniform vec3 positionOffset = vec3(0.0);
+
 void main()
 {
-    gl_Position = model * vec4(aPos, 1.0);
+    vec3 objectPosition = aPos * positionScale + positionOffset;
+    gl_Position = model * vec4(objectPosition, 1.0);
 }
\ No newline at end of file
@@ -5,6 +5,11 @@ layout(location = 0) in vec3 position;
 uniform mat4 M;
 uniform mat4 VP;
 
+// Model::VertexFormat::Compact, position is unorm16 in the model bounds
+uniform vec3 positionScale = vec3(1.0);
+uniform vec3 positionOffset = vec3(0.0);
+
 void main(){
-    gl_Position = VP * M * vec4(position, 1.0);
+    vec3 objectPosition = position * positionScale + positionOffset;
+    gl_Position = VP * M * vec4(objectPosition, 1.0);
 }
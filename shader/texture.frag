@@ -36,17 +36,6 @@ struct Material {
     float shininess;
 };
 
-struct Config {
-    bool blinnPhong;
-    bool directionalLightShadow;
-    bool bloom;
-    bool deferredShading;
-    bool normalMapping;
-    bool NPR;
-    bool SSAO;
-    bool areaLight;
-};
-
 struct View {
     int width;
     int height;
@@ -93,7 +82,8 @@ const float LUT_SCALE = (LUT_SIZE - 1.0)/LUT_SIZE;
 const float LUT_BIAS  = 0.5/LUT_SIZE;
 // Area_Light Uniforms End
 
-uniform Config config;
+// Features are compiled in per variant, Shader injects these after #version:
+// BLINN_PHONG, DIRECTIONAL_LIGHT_SHADOW, BLOOM, NPR, SSAO, AREA_LIGHT
 
 // Vector form without project to the plane (dot with the normal)
 // Use for proxy sphere clipping
@@ -199,8 +189,9 @@ void main(void)
     vec4 textureColor = texture(textureMap, textureCoordinate).rgba;
     vec3 normalizedNormal = normalize(normal);
     if (hasNormalMap) {
-        normalizedNormal = texture(NormalMap, textureCoordinate).rgb;
-        normalizedNormal = normalizedNormal * 2.0 - 1.0;
+        // two channel BC5, z is rebuilt from the unit length
+        normalizedNormal.xy = texture(NormalMap, textureCoordinate).rg * 2.0 - 1.0;
+        normalizedNormal.z = sqrt(max(1.0 - dot(normalizedNormal.xy, normalizedNormal.xy), 0.0));
         normalizedNormal = normalize(TBN * normalizedNormal);
     }
     vec3 lightDirection = normalize(directionalLight.position - position);
@@ -220,22 +211,23 @@ void main(void)
     vec3 specular = vec3(0.0);
     color = vec4(diffuse, 1.0);
 
-    if (config.SSAO) {
-        vec2 p = vec2(gl_FragCoord.x / viewport.width, gl_FragCoord.y / viewport.height);
-        ambient *= vec4(vec3(texture(SSAO_Map, p)), 1.0).r;
-    }
+#ifdef SSAO
+    vec2 p = vec2(gl_FragCoord.x / viewport.width, gl_FragCoord.y / viewport.height);
+    ambient *= vec4(vec3(texture(SSAO_Map, p)), 1.0).r;
+#endif
 
-    if (config.blinnPhong) {
-        diffuse = max(dot(normalizedNormal, directionalLight_LightDirection), 0.0) * textureColor.rgb * material.diffuse * directionalLight.diffuse;
-        specular = pow(max(dot(normalizedNormal, directionalLight_HalfwayDirection), 0.0), material.shininess) * material.specular * directionalLight.specular;
-        color = vec4((ambient + diffuse + specular), 1.0);
-    }
+#ifdef BLINN_PHONG
+    diffuse = max(dot(normalizedNormal, directionalLight_LightDirection), 0.0) * textureColor.rgb * material.diffuse * directionalLight.diffuse;
+    specular = pow(max(dot(normalizedNormal, directionalLight_HalfwayDirection), 0.0), material.shininess) * material.specular * directionalLight.specular;
+    color = vec4((ambient + diffuse + specular), 1.0);
+#endif
 
-    if (config.NPR) {
-        nDotL = dot(normalizedNormal, lightDirection);
-        diffuse = diffuse * floor(nDotL * 3) / 3;
-    }
+#ifdef NPR
+    nDotL = dot(normalizedNormal, lightDirection);
+    diffuse = diffuse * floor(nDotL * 3) / 3;
+#endif
 
+#ifdef DIRECTIONAL_LIGHT_SHADOW
     // directional light shadow
     float bias = max(0.06 * (1.0 - dot(normalizedNormal, directionalLight_LightDirection)), 0.01);
 
@@ -250,13 +242,11 @@ void main(void)
     shadow /= 121.0;
     shadow = 1 - shadow;
 
-    if (config.directionalLightShadow) {
-        color = vec4((ambient + shadow * (diffuse + specular)), 1.0);
-    }
-
-    
+    color = vec4((ambient + shadow * (diffuse + specular)), 1.0);
+#endif
 
-    if (config.bloom) {
+#ifdef BLOOM
+    {
         // /*----- Bloom Effect Begin ----- */
         vec3 Bloom_lightDir = normalize(emissive_sphere_position - position);
         // diffuse shading
@@ -274,10 +264,10 @@ void main(void)
         vec3 Bloom_specular = directionalLight.specular * Bloom_spec * material.specular;
         Bloom_ambient  *= attenuation;
         Bloom_diffuse  *= attenuation;
-        if (config.NPR) {
-            nDotL = dot(normalizedNormal, Bloom_lightDir);
-            Bloom_diffuse = Bloom_diffuse * floor(nDotL * 3) / 3;
-        }
+#ifdef NPR
+        nDotL = dot(normalizedNormal, Bloom_lightDir);
+        Bloom_diffuse = Bloom_diffuse * floor(nDotL * 3) / 3;
+#endif
         Bloom_specular *= attenuation;
 
         // point light shadow
@@ -285,11 +275,11 @@ void main(void)
         float closestDepth = texture(pointShadowMap, fragToLight).r;
         closestDepth *= farPlane;
         float currentDepth = length(fragToLight);
-        bias = 0.05; // we use a much larger bias since depth is now in [near_plane, far_plane] range
-        shadow = currentDepth -  bias > closestDepth ? 1.0 : 0.0;  
-        shadow = (1.0 - shadow);
+        float pointBias = 0.05; // we use a much larger bias since depth is now in [near_plane, far_plane] range
+        float pointShadow = currentDepth -  pointBias > closestDepth ? 1.0 : 0.0;
+        pointShadow = (1.0 - pointShadow);
         
-        vec3 Bloom_color = Bloom_ambient + Bloom_diffuse * shadow + Bloom_specular * shadow;
+        vec3 Bloom_color = Bloom_ambient + Bloom_diffuse * pointShadow + Bloom_specular * pointShadow;
         color = vec4(color.xyz+Bloom_color, 1.0);
         if (isLightObject == true) color = vec4(vec3(2.0), 1.0);
         
@@ -300,8 +290,10 @@ void main(void)
             BloomEffect_BrightColor = vec4(0.0, 0.0, 0.0, 1.0);
         // /*----- Bloom Effect End -----*/
     }
+#endif
 
-    if (config.areaLight) {
+#ifdef AREA_LIGHT
+    {
         specular = ToLinear(material.specular);
         vec3 result = vec3(0.0f);
 
@@ -353,4 +345,5 @@ void main(void)
         result = ToSRGB(result);
         color += vec4(result, 1.0f);
     }
+#endif
 }
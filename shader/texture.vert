@@ -16,18 +16,35 @@ uniform mat4 view;
 uniform mat4 projection;
 uniform mat4 depthMVP;
 
+// Model::VertexFormat::Compact, position is unorm16 in the model bounds, normal and tangent are octahedral
+uniform bool compactVertices = false;
+uniform vec3 positionScale = vec3(1.0);
+uniform vec3 positionOffset = vec3(0.0);
+
+vec3 octahedralDecode(vec2 e)
+{
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+    return normalize(n);
+}
+
 void main(void)
 {
-    position = vec3(model * vec4(inPosition, 1.0));
-    normal = mat3(transpose(inverse(model))) * inNormal;
-    vec3 T = normalize(vec3(model * vec4(inTangent, 0.0)));
-    vec3 N = normalize(vec3(model * vec4(inNormal, 0.0)));
+    vec3 objectPosition = inPosition * positionScale + positionOffset;
+    vec3 objectNormal = compactVertices ? octahedralDecode(inNormal.xy) : inNormal;
+    vec3 objectTangent = compactVertices ? octahedralDecode(inTangent.xy) : inTangent;
+
+    position = vec3(model * vec4(objectPosition, 1.0));
+    normal = mat3(transpose(inverse(model))) * objectNormal;
+    vec3 T = normalize(vec3(model * vec4(objectTangent, 0.0)));
+    vec3 N = normalize(vec3(model * vec4(objectNormal, 0.0)));
     T = normalize(T - dot(T, N) * N);
     vec3 B = cross(N, T);
     TBN = mat3(T, B, N);
     textureCoordinate = inTexture;
 
-    shadowPosition = vec3(depthMVP * vec4(inPosition, 1.0));
+    shadowPosition = vec3(depthMVP * vec4(objectPosition, 1.0));
 
-    gl_Position = projection * view * model * vec4(inPosition, 1.0);
+    gl_Position = projection * view * model * vec4(objectPosition, 1.0);
 }
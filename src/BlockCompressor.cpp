@@ -0,0 +1,429 @@
+#include "BlockCompressor.h"
+#include "ThreadPool.h"
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+
+namespace {
+    // the per texel loops run over fixed size float arrays so the compiler can vectorize them
+    struct ColorBlock {
+        float r[16], g[16], b[16], a[16];
+    };
+
+    ColorBlock loadBlock(const unsigned char *block) {
+        ColorBlock colors;
+        for (int i = 0; i < 16; i++) {
+            colors.r[i] = block[i * 4];
+            colors.g[i] = block[i * 4 + 1];
+            colors.b[i] = block[i * 4 + 2];
+            colors.a[i] = block[i * 4 + 3];
+        }
+        return colors;
+    }
+
+    // LSB first bit packing into a zeroed block
+    class BitWriter
+    {
+    public:
+        explicit BitWriter(unsigned char *output) : output(output) {}
+
+        void write(unsigned int value, unsigned int count) {
+            for (unsigned int i = 0; i < count; i++, position++) {
+                if ((value >> i) & 1u)
+                    output[position >> 3] |= (unsigned char) (1u << (position & 7));
+            }
+        }
+
+    private:
+        unsigned char *output;
+        unsigned int position = 0;
+    };
+
+    // Principal axis of the texels by power iteration on the covariance, channels past `channels` are ignored.
+    // Returns the mean and the axis, the axis falls back to the diagonal for flat blocks.
+    void principalAxis(const ColorBlock &colors, int channels, float mean[4], float axis[4]) {
+        const float *data[4] = {colors.r, colors.g, colors.b, colors.a};
+        for (int c = 0; c < 4; c++) {
+            float sum = 0.0f;
+            for (int i = 0; i < 16; i++)
+                sum += data[c][i];
+            mean[c] = c < channels ? sum / 16.0f : 0.0f;
+        }
+        float covariance[4][4] = {};
+        for (int c0 = 0; c0 < channels; c0++) {
+            for (int c1 = c0; c1 < channels; c1++) {
+                float sum = 0.0f;
+                for (int i = 0; i < 16; i++)
+                    sum += (data[c0][i] - mean[c0]) * (data[c1][i] - mean[c1]);
+                covariance[c0][c1] = covariance[c1][c0] = sum;
+            }
+        }
+
+        float vector[4] = {1.0f, 1.0f, 1.0f, channels == 4 ? 1.0f : 0.0f};
+        for (int iteration = 0; iteration < 8; iteration++) {
+            float next[4] = {};
+            for (int c0 = 0; c0 < channels; c0++)
+                for (int c1 = 0; c1 < channels; c1++)
+                    next[c0] += covariance[c0][c1] * vector[c1];
+            float length = 0.0f;
+            for (int c = 0; c < channels; c++)
+                length = std::max(length, std::abs(next[c]));
+            if (length < 1e-6f)
+                break;
+            for (int c = 0; c < 4; c++)
+                vector[c] = next[c] / length;
+        }
+        float length = 0.0f;
+        for (int c = 0; c < channels; c++)
+            length += vector[c] * vector[c];
+        length = std::sqrt(length);
+        for (int c = 0; c < 4; c++)
+            axis[c] = c < channels && length > 0.0f ? vector[c] / length : 0.0f;
+    }
+
+    // texel extremes along the axis
+    void axisBounds(const ColorBlock &colors, int channels, const float mean[4], const float axis[4],
+                    float lower[4], float upper[4]) {
+        const float *data[4] = {colors.r, colors.g, colors.b, colors.a};
+        float minimum = 0.0f, maximum = 0.0f;
+        for (int i = 0; i < 16; i++) {
+            float t = 0.0f;
+            for (int c = 0; c < channels; c++)
+                t += (data[c][i] - mean[c]) * axis[c];
+            minimum = std::min(minimum, t);
+            maximum = std::max(maximum, t);
+        }
+        for (int c = 0; c < 4; c++) {
+            lower[c] = std::min(std::max(mean[c] + axis[c] * minimum, 0.0f), 255.0f);
+            upper[c] = std::min(std::max(mean[c] + axis[c] * maximum, 0.0f), 255.0f);
+        }
+    }
+
+    // nearest palette entry of every texel, returns the summed squared error
+    float assignIndices(const ColorBlock &colors, int channels, const float palette[][4], int paletteSize,
+                        unsigned char indices[16]) {
+        const float *data[4] = {colors.r, colors.g, colors.b, colors.a};
+        float total = 0.0f;
+        for (int i = 0; i < 16; i++) {
+            float best = 1e30f;
+            for (int p = 0; p < paletteSize; p++) {
+                float error = 0.0f;
+                for (int c = 0; c < channels; c++) {
+                    float d = data[c][i] - palette[p][c];
+                    error += d * d;
+                }
+                if (error < best) {
+                    best = error;
+                    indices[i] = (unsigned char) p;
+                }
+            }
+            total += best;
+        }
+        return total;
+    }
+
+    // Least squares endpoints for fixed indices, each texel is weights[index] of the way from e0 to e1.
+    // Returns false when every texel uses the same weight.
+    bool refineEndpoints(const ColorBlock &colors, int channels, const unsigned char indices[16],
+                         const float *weights, float e0[4], float e1[4]) {
+        const float *data[4] = {colors.r, colors.g, colors.b, colors.a};
+        float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+        float ax[4] = {}, bx[4] = {};
+        for (int i = 0; i < 16; i++) {
+            float b = weights[indices[i]];
+            float a = 1.0f - b;
+            aa += a * a;
+            ab += a * b;
+            bb += b * b;
+            for (int c = 0; c < channels; c++) {
+                ax[c] += a * data[c][i];
+                bx[c] += b * data[c][i];
+            }
+        }
+        float determinant = aa * bb - ab * ab;
+        if (std::abs(determinant) < 1e-6f)
+            return false;
+        for (int c = 0; c < channels; c++) {
+            e0[c] = std::min(std::max((ax[c] * bb - bx[c] * ab) / determinant, 0.0f), 255.0f);
+            e1[c] = std::min(std::max((bx[c] * aa - ax[c] * ab) / determinant, 0.0f), 255.0f);
+        }
+        return true;
+    }
+
+    /*----- BC1 colour block -----*/
+
+    uint16_t packRgb565(const float color[4]) {
+        unsigned int r = (unsigned int) std::lround(color[0] * 31.0f / 255.0f);
+        unsigned int g = (unsigned int) std::lround(color[1] * 63.0f / 255.0f);
+        unsigned int b = (unsigned int) std::lround(color[2] * 31.0f / 255.0f);
+        return (uint16_t) ((r << 11) | (g << 5) | b);
+    }
+
+    void unpackRgb565(uint16_t packed, float color[4]) {
+        unsigned int r = (packed >> 11) & 31, g = (packed >> 5) & 63, b = packed & 31;
+        color[0] = (float) ((r << 3) | (r >> 2));
+        color[1] = (float) ((g << 2) | (g >> 4));
+        color[2] = (float) ((b << 3) | (b >> 2));
+        color[3] = 255.0f;
+    }
+
+    // index order of the four colour mode: c0, c1, 2/3 c0 + 1/3 c1, 1/3 c0 + 2/3 c1
+    const float colorWeights[4] = {0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f};
+
+    float encodeColorEndpoints(const ColorBlock &colors, const float e0[4], const float e1[4], uint16_t &color0,
+                               uint16_t &color1, unsigned char indices[16]) {
+        color0 = packRgb565(e0);
+        color1 = packRgb565(e1);
+        // four colour mode needs color0 > color1, equal endpoints only ever use index 0
+        if (color0 < color1)
+            std::swap(color0, color1);
+        float palette[4][4];
+        unpackRgb565(color0, palette[0]);
+        unpackRgb565(color1, palette[1]);
+        if (color0 == color1) {
+            std::fill(indices, indices + 16, 0);
+            return assignIndices(colors, 3, palette, 1, indices);
+        }
+        for (int c = 0; c < 3; c++) {
+            palette[2][c] = std::floor((2.0f * palette[0][c] + palette[1][c]) / 3.0f);
+            palette[3][c] = std::floor((palette[0][c] + 2.0f * palette[1][c]) / 3.0f);
+        }
+        return assignIndices(colors, 3, palette, 4, indices);
+    }
+
+    void compressColorBlock(const ColorBlock &colors, unsigned char *output) {
+        float mean[4], axis[4], e0[4], e1[4];
+        principalAxis(colors, 3, mean, axis);
+        axisBounds(colors, 3, mean, axis, e1, e0);
+
+        uint16_t color0, color1;
+        unsigned char indices[16];
+        float error = encodeColorEndpoints(colors, e0, e1, color0, color1, indices);
+        for (int iteration = 0; iteration < 2 && error > 0.0f && color0 != color1; iteration++) {
+            float r0[4], r1[4];
+            unpackRgb565(color0, r0);
+            unpackRgb565(color1, r1);
+            if (!refineEndpoints(colors, 3, indices, colorWeights, r0, r1))
+                break;
+            uint16_t refined0, refined1;
+            unsigned char refinedIndices[16];
+            float refinedError = encodeColorEndpoints(colors, r0, r1, refined0, refined1, refinedIndices);
+            if (refinedError >= error)
+                break;
+            error = refinedError;
+            color0 = refined0;
+            color1 = refined1;
+            memcpy(indices, refinedIndices, sizeof(indices));
+        }
+
+        output[0] = (unsigned char) (color0 & 0xFF);
+        output[1] = (unsigned char) (color0 >> 8);
+        output[2] = (unsigned char) (color1 & 0xFF);
+        output[3] = (unsigned char) (color1 >> 8);
+        uint32_t packed = 0;
+        for (int i = 0; i < 16; i++)
+            packed |= (uint32_t) indices[i] << (i * 2);
+        for (int i = 0; i < 4; i++)
+            output[4 + i] = (unsigned char) (packed >> (i * 8));
+    }
+
+    /*----- BC4 single channel block, alpha of BC3 and both halves of BC5 -----*/
+
+    float encodeChannel(const float *values, unsigned int a0, unsigned int a1, unsigned char indices[16]) {
+        float palette[8][4] = {};
+        palette[0][0] = (float) a0;
+        palette[1][0] = (float) a1;
+        if (a0 > a1) {
+            for (int i = 2; i < 8; i++)
+                palette[i][0] = (float) (((8 - i) * a0 + (i - 1) * a1) / 7);
+        } else {
+            for (int i = 2; i < 6; i++)
+                palette[i][0] = (float) (((6 - i) * a0 + (i - 1) * a1) / 5);
+            palette[6][0] = 0.0f;
+            palette[7][0] = 255.0f;
+        }
+        ColorBlock channel{};
+        memcpy(channel.r, values, sizeof(channel.r));
+        return assignIndices(channel, 1, palette, 8, indices);
+    }
+
+    void compressChannelBlock(const float *values, unsigned char *output) {
+        float minimum = 255.0f, maximum = 0.0f;
+        // the six value mode has exact 0 and 255 entries, its endpoints only span what lies between them
+        float innerMinimum = 255.0f, innerMaximum = 0.0f;
+        for (int i = 0; i < 16; i++) {
+            minimum = std::min(minimum, values[i]);
+            maximum = std::max(maximum, values[i]);
+            if (values[i] > 0.0f && values[i] < 255.0f) {
+                innerMinimum = std::min(innerMinimum, values[i]);
+                innerMaximum = std::max(innerMaximum, values[i]);
+            }
+        }
+
+        unsigned int a0 = (unsigned int) maximum, a1 = (unsigned int) minimum;
+        unsigned char indices[16];
+        float error = encodeChannel(values, a0, a1, indices);
+        if (error > 0.0f && (minimum == 0.0f || maximum == 255.0f)) {
+            if (innerMinimum > innerMaximum)
+                innerMinimum = innerMaximum = 0.0f;
+            unsigned char sixIndices[16];
+            unsigned int b0 = (unsigned int) innerMinimum, b1 = (unsigned int) innerMaximum;
+            float sixError = encodeChannel(values, b0, b1, sixIndices);
+            if (sixError < error) {
+                a0 = b0;
+                a1 = b1;
+                memcpy(indices, sixIndices, sizeof(indices));
+            }
+        }
+
+        output[0] = (unsigned char) a0;
+        output[1] = (unsigned char) a1;
+        uint64_t packed = 0;
+        for (int i = 0; i < 16; i++)
+            packed |= (uint64_t) indices[i] << (i * 3);
+        for (int i = 0; i < 6; i++)
+            output[2 + i] = (unsigned char) (packed >> (i * 8));
+    }
+
+    /*----- BC7 mode 6 -----*/
+
+    const unsigned int bc7Weights[16] = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+
+    // 7 bit endpoint plus the shared low bit that gives the smaller error
+    void quantizeBc7Endpoint(const float endpoint[4], unsigned int quantized[4], unsigned int &pBit) {
+        float bestError = 1e30f;
+        for (unsigned int p = 0; p < 2; p++) {
+            unsigned int candidate[4];
+            float error = 0.0f;
+            for (int c = 0; c < 4; c++) {
+                int q = (int) std::lround((endpoint[c] - (float) p) * 0.5f);
+                candidate[c] = (unsigned int) std::min(std::max(q, 0), 127);
+                float d = endpoint[c] - (float) ((candidate[c] << 1) | p);
+                error += d * d;
+            }
+            if (error < bestError) {
+                bestError = error;
+                pBit = p;
+                memcpy(quantized, candidate, sizeof(candidate));
+            }
+        }
+    }
+
+    float encodeBc7Endpoints(const ColorBlock &colors, const float e0[4], const float e1[4], unsigned int q0[4],
+                             unsigned int &p0, unsigned int q1[4], unsigned int &p1, unsigned char indices[16]) {
+        quantizeBc7Endpoint(e0, q0, p0);
+        quantizeBc7Endpoint(e1, q1, p1);
+        float palette[16][4];
+        for (int i = 0; i < 16; i++) {
+            for (int c = 0; c < 4; c++) {
+                unsigned int v0 = (q0[c] << 1) | p0, v1 = (q1[c] << 1) | p1;
+                palette[i][c] = (float) (((64 - bc7Weights[i]) * v0 + bc7Weights[i] * v1 + 32) >> 6);
+            }
+        }
+        return assignIndices(colors, 4, palette, 16, indices);
+    }
+
+    void compressBc7Block(const ColorBlock &colors, unsigned char *output) {
+        float mean[4], axis[4], e0[4], e1[4];
+        principalAxis(colors, 4, mean, axis);
+        axisBounds(colors, 4, mean, axis, e0, e1);
+
+        unsigned int q0[4], q1[4], p0, p1;
+        unsigned char indices[16];
+        float error = encodeBc7Endpoints(colors, e0, e1, q0, p0, q1, p1, indices);
+
+        float weights[16];
+        for (int i = 0; i < 16; i++)
+            weights[i] = (float) bc7Weights[i] / 64.0f;
+        for (int iteration = 0; iteration < 2 && error > 0.0f; iteration++) {
+            float r0[4], r1[4];
+            for (int c = 0; c < 4; c++) {
+                r0[c] = (float) ((q0[c] << 1) | p0);
+                r1[c] = (float) ((q1[c] << 1) | p1);
+            }
+            if (!refineEndpoints(colors, 4, indices, weights, r0, r1))
+                break;
+            unsigned int rq0[4], rq1[4], rp0, rp1;
+            unsigned char refinedIndices[16];
+            float refinedError = encodeBc7Endpoints(colors, r0, r1, rq0, rp0, rq1, rp1, refinedIndices);
+            if (refinedError >= error)
+                break;
+            error = refinedError;
+            memcpy(q0, rq0, sizeof(q0));
+            memcpy(q1, rq1, sizeof(q1));
+            p0 = rp0;
+            p1 = rp1;
+            memcpy(indices, refinedIndices, sizeof(indices));
+        }
+
+        // the anchor texel stores only 3 index bits, so its index must be below 8
+        if (indices[0] & 8) {
+            std::swap(q0, q1);
+            std::swap(p0, p1);
+            for (auto &index: indices)
+                index = (unsigned char) (15 - index);
+        }
+
+        memset(output, 0, 16);
+        BitWriter bits(output);
+        bits.write(1u << 6, 7);
+        for (int c = 0; c < 4; c++) {
+            bits.write(q0[c], 7);
+            bits.write(q1[c], 7);
+        }
+        bits.write(p0, 1);
+        bits.write(p1, 1);
+        for (int i = 0; i < 16; i++)
+            bits.write(indices[i], i == 0 ? 3 : 4);
+    }
+}
+
+size_t BlockCompressor::blockSize(Format format) {
+    return format == Format::BC1 ? 8 : 16;
+}
+
+size_t BlockCompressor::compressedSize(Format format, int width, int height) {
+    return (size_t) ((width + 3) / 4) * (size_t) ((height + 3) / 4) * blockSize(format);
+}
+
+void BlockCompressor::compressBlock(const unsigned char *block, Format format, unsigned char *output) {
+    ColorBlock colors = loadBlock(block);
+    switch (format) {
+        case Format::BC1:
+            compressColorBlock(colors, output);
+            break;
+        case Format::BC3:
+            compressChannelBlock(colors.a, output);
+            compressColorBlock(colors, output + 8);
+            break;
+        case Format::BC5:
+            compressChannelBlock(colors.r, output);
+            compressChannelBlock(colors.g, output + 8);
+            break;
+        case Format::BC7:
+            compressBc7Block(colors, output);
+            break;
+    }
+}
+
+std::vector<unsigned char> BlockCompressor::compress(const unsigned char *rgba, int width, int height, Format format) {
+    int blocksWide = (width + 3) / 4, blocksHigh = (height + 3) / 4;
+    size_t size = blockSize(format);
+    std::vector<unsigned char> output(compressedSize(format, width, height));
+    ThreadPool::shared().parallelFor((size_t) blocksHigh, [&](size_t blockRow) {
+        unsigned char block[64];
+        for (int blockColumn = 0; blockColumn < blocksWide; blockColumn++) {
+            for (int y = 0; y < 4; y++) {
+                int row = std::min((int) blockRow * 4 + y, height - 1);
+                for (int x = 0; x < 4; x++) {
+                    int column = std::min(blockColumn * 4 + x, width - 1);
+                    memcpy(block + (y * 4 + x) * 4, rgba + ((size_t) row * width + column) * 4, 4);
+                }
+            }
+            compressBlock(block, format, output.data() + (blockRow * blocksWide + blockColumn) * size);
+        }
+    });
+    return output;
+}
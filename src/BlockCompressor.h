@@ -0,0 +1,28 @@
+#ifndef GRAPHICS_PROGRAMMING_BLOCK_COMPRESSOR_H
+#define GRAPHICS_PROGRAMMING_BLOCK_COMPRESSOR_H
+
+#include <vector>
+#include <cstddef>
+
+// CPU encoder for the BCn block formats, used when textures are baked.
+// Input is RGBA8, every 4x4 texel block is encoded on its own, so rows of blocks are spread over the ThreadPool.
+// Edge blocks of images that are not a multiple of 4 repeat their last row and column.
+class BlockCompressor
+{
+public:
+    enum class Format {
+        BC1,    // RGB, 8 bytes per block
+        BC3,    // RGB plus an interpolated alpha block, 16 bytes
+        BC5,    // two independent channels from R and G, 16 bytes, for tangent space normals
+        BC7     // RGBA, 16 bytes, mode 6 only: one subset with 7 bit endpoints and 16 index levels
+    };
+
+    static size_t blockSize(Format format);
+    static size_t compressedSize(Format format, int width, int height);
+
+    static std::vector<unsigned char> compress(const unsigned char* rgba, int width, int height, Format format);
+
+    // block holds 16 RGBA texels in row order
+    static void compressBlock(const unsigned char* block, Format format, unsigned char* output);
+};
+#endif //GRAPHICS_PROGRAMMING_BLOCK_COMPRESSOR_H
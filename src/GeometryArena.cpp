@@ -0,0 +1,122 @@
+#include "GeometryArena.h"
+
+#include <algorithm>
+#include <iostream>
+
+namespace {
+    // a 32 bit index range must start on a 4 byte boundary
+    const size_t indexAlignment = 4;
+}
+
+GeometryArena::RangeAllocator::RangeAllocator(size_t capacity) {
+    if (capacity > 0)
+        freeRanges[0] = capacity;
+}
+
+bool GeometryArena::RangeAllocator::allocate(size_t size, size_t alignment, size_t &offset) {
+    if (size == 0) {
+        offset = 0;
+        return true;
+    }
+    for (auto it = freeRanges.begin(); it != freeRanges.end(); ++it) {
+        size_t start = it->first;
+        size_t aligned = (start + alignment - 1) / alignment * alignment;
+        size_t end = start + it->second;
+        if (aligned + size > end)
+            continue;
+        freeRanges.erase(it);
+        if (aligned > start)
+            freeRanges[start] = aligned - start;
+        if (aligned + size < end)
+            freeRanges[aligned + size] = end - aligned - size;
+        offset = aligned;
+        return true;
+    }
+    return false;
+}
+
+void GeometryArena::RangeAllocator::release(size_t offset, size_t size) {
+    if (size == 0)
+        return;
+    auto it = freeRanges.emplace(offset, size).first;
+    auto next = std::next(it);
+    if (next != freeRanges.end() && it->first + it->second == next->first) {
+        it->second += next->second;
+        freeRanges.erase(next);
+    }
+    if (it != freeRanges.begin()) {
+        auto previous = std::prev(it);
+        if (previous->first + previous->second == it->first) {
+            previous->second += it->second;
+            freeRanges.erase(it);
+        }
+    }
+}
+
+GeometryArena::GeometryArena(GLsizei vertexStride, std::function<void()> setupAttributes,
+                             size_t blockVertexBytes, size_t blockIndexBytes)
+        : vertexStride(vertexStride), setupAttributes(std::move(setupAttributes)),
+          blockVertexBytes(blockVertexBytes), blockIndexBytes(blockIndexBytes) {}
+
+GeometryArena::~GeometryArena() {
+    for (auto &block: blocks) {
+        glDeleteVertexArrays(1, &block.vao);
+        glDeleteBuffers(1, &block.vertexBuffer);
+        glDeleteBuffers(1, &block.indexBuffer);
+    }
+}
+
+GeometryArena::Allocation GeometryArena::allocate(size_t vertexCount, size_t indexBytes) {
+    Allocation allocation;
+    allocation.vertexCount = vertexCount;
+    allocation.indexBytes = indexBytes;
+    for (unsigned int i = 0; i < blocks.size(); i++) {
+        size_t firstVertex, indexOffset;
+        if (!blocks[i].vertices.allocate(vertexCount, 1, firstVertex))
+            continue;
+        if (!blocks[i].indices.allocate(indexBytes, indexAlignment, indexOffset)) {
+            blocks[i].vertices.release(firstVertex, vertexCount);
+            continue;
+        }
+        allocation.block = i;
+        allocation.baseVertex = (GLint) firstVertex;
+        allocation.indexOffset = indexOffset;
+        return allocation;
+    }
+
+    // a mesh bigger than a whole block gets a block of its own size
+    addBlock(std::max(vertexCount, blockVertexBytes / vertexStride), std::max(indexBytes, blockIndexBytes));
+    size_t firstVertex = 0, indexOffset = 0;
+    blocks.back().vertices.allocate(vertexCount, 1, firstVertex);
+    blocks.back().indices.allocate(indexBytes, indexAlignment, indexOffset);
+    allocation.block = (unsigned int) (blocks.size() - 1);
+    allocation.baseVertex = (GLint) firstVertex;
+    allocation.indexOffset = indexOffset;
+    return allocation;
+}
+
+void GeometryArena::release(const Allocation &allocation) {
+    Block &block = blocks[allocation.block];
+    block.vertices.release((size_t) allocation.baseVertex, allocation.vertexCount);
+    block.indices.release(allocation.indexOffset, allocation.indexBytes);
+}
+
+void GeometryArena::addBlock(size_t vertexCapacity, size_t indexBytes) {
+    Block block{0, 0, 0, RangeAllocator(vertexCapacity), RangeAllocator(indexBytes)};
+    glGenVertexArrays(1, &block.vao);
+    glGenBuffers(1, &block.vertexBuffer);
+    glGenBuffers(1, &block.indexBuffer);
+
+    glBindVertexArray(block.vao);
+    glBindBuffer(GL_ARRAY_BUFFER, block.vertexBuffer);
+    glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr) (vertexCapacity * vertexStride), nullptr, GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, block.indexBuffer);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, (GLsizeiptr) indexBytes, nullptr, GL_STATIC_DRAW);
+    setupAttributes();
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    std::cout << "Geometry arena block " << blocks.size() << ": " << vertexCapacity << " vertices, "
+              << indexBytes / 1024 << " KB indices" << std::endl;
+    blocks.push_back(std::move(block));
+}
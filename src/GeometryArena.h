@@ -0,0 +1,72 @@
+#ifndef GRAPHICS_PROGRAMMING_GEOMETRY_ARENA_H
+#define GRAPHICS_PROGRAMMING_GEOMETRY_ARENA_H
+
+#include <map>
+#include <vector>
+#include <functional>
+#include <cstddef>
+
+#include "GL/glew.h"
+
+// Shared vertex and index storage for every mesh of one vertex layout.
+// Meshes are sub-allocated from large blocks, each block is one vertex buffer, one index buffer and
+// one VAO, so consecutive draws from the same block need no rebinding and use glDrawElementsBaseVertex.
+// A new block is only opened when the current ones are full.
+// Must only be used on the thread that owns the GL context.
+class GeometryArena
+{
+public:
+    struct Allocation {
+        unsigned int block = 0;
+        GLint baseVertex = 0;       // first vertex, in vertices
+        size_t vertexCount = 0;
+        size_t indexOffset = 0;     // first index, in bytes
+        size_t indexBytes = 0;
+    };
+
+    // setupAttributes runs with a block's VAO and vertex buffer bound
+    GeometryArena(GLsizei vertexStride, std::function<void()> setupAttributes,
+                  size_t blockVertexBytes = 32 * 1024 * 1024, size_t blockIndexBytes = 16 * 1024 * 1024);
+    ~GeometryArena();
+
+    GeometryArena(const GeometryArena&) = delete;
+    GeometryArena& operator=(const GeometryArena&) = delete;
+
+    Allocation allocate(size_t vertexCount, size_t indexBytes);
+    void release(const Allocation& allocation);
+
+    GLuint vertexArray(unsigned int block) const { return blocks[block].vao; }
+    GLuint vertexBuffer(unsigned int block) const { return blocks[block].vertexBuffer; }
+    GLuint indexBuffer(unsigned int block) const { return blocks[block].indexBuffer; }
+    size_t vertexOffset(const Allocation& allocation) const { return (size_t) allocation.baseVertex * vertexStride; }
+
+private:
+    // first fit over free ranges, neighbours merge on release
+    class RangeAllocator
+    {
+    public:
+        explicit RangeAllocator(size_t capacity);
+        bool allocate(size_t size, size_t alignment, size_t& offset);
+        void release(size_t offset, size_t size);
+
+    private:
+        std::map<size_t, size_t> freeRanges;
+    };
+
+    struct Block {
+        GLuint vao;
+        GLuint vertexBuffer;
+        GLuint indexBuffer;
+        RangeAllocator vertices;    // in vertices
+        RangeAllocator indices;     // in bytes
+    };
+
+    GLsizei vertexStride;
+    std::function<void()> setupAttributes;
+    size_t blockVertexBytes;
+    size_t blockIndexBytes;
+    std::vector<Block> blocks;
+
+    void addBlock(size_t vertexCapacity, size_t indexBytes);
+};
+#endif //GRAPHICS_PROGRAMMING_GEOMETRY_ARENA_H
@@ -0,0 +1,73 @@
+#include "LtcTables.h"
+
+#include <cstring>
+#include <cstdio>
+#include <vector>
+#include <fstream>
+
+#include "glm/gtc/packing.hpp"
+
+namespace {
+    const char blobMagic[4] = {'G', 'L', 'T', 'C'};
+
+    struct Header {
+        char magic[4];
+        uint32_t version;
+        uint32_t width;
+        uint32_t height;
+        uint32_t tableCount;
+        uint32_t reserved;
+    };
+
+    const size_t blobSize = sizeof(Header) + LtcTables::tableCount * LtcTables::tableLength * sizeof(uint16_t);
+}
+
+bool LtcTables::open(const std::string &path) {
+    if (!file.open(path))
+        return false;
+    Header header{};
+    if (file.size() != blobSize) {
+        file.close();
+        return false;
+    }
+    memcpy(&header, file.data(), sizeof(header));
+    if (memcmp(header.magic, blobMagic, sizeof(blobMagic)) != 0 || header.version != version ||
+        header.width != size || header.height != size || header.tableCount != tableCount) {
+        file.close();
+        return false;
+    }
+    return true;
+}
+
+const uint16_t *LtcTables::table(int index) const {
+    return reinterpret_cast<const uint16_t *>(file.data() + sizeof(Header)) + tableLength * index;
+}
+
+bool LtcTables::write(const std::string &path, const float *const tables[tableCount]) {
+    Header header{};
+    memcpy(header.magic, blobMagic, sizeof(blobMagic));
+    header.version = version;
+    header.width = size;
+    header.height = size;
+    header.tableCount = tableCount;
+
+    std::vector<uint16_t> halves(tableCount * tableLength);
+    for (int table = 0; table < tableCount; table++) {
+        for (size_t i = 0; i < tableLength; i++)
+            halves[table * tableLength + i] = glm::packHalf1x16(tables[table][i]);
+    }
+
+    std::string tempPath = path + ".tmp";
+    std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+    if (!out)
+        return false;
+    out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char *>(halves.data()), (std::streamsize) (halves.size() * sizeof(uint16_t)));
+    out.close();
+    std::remove(path.c_str());
+    if (!out || std::rename(tempPath.c_str(), path.c_str()) != 0) {
+        std::remove(tempPath.c_str());
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,32 @@
+#ifndef GRAPHICS_PROGRAMMING_LTC_TABLES_H
+#define GRAPHICS_PROGRAMMING_LTC_TABLES_H
+
+#include <string>
+#include <cstdint>
+
+#include "MappedFile.h"
+
+// Lookup tables of the linearly transformed cosines area light, stored as a packed RGBA16F blob that is
+// memory mapped and handed to glTexSubImage2D as is. tools/LtcTableWriter.cpp writes and verifies the blob.
+// Table 0 is the inverse M, table 1 holds GGX norm, fresnel, 0 (unused) and the sphere for horizon clipping.
+class LtcTables
+{
+public:
+    static const uint32_t version = 1;
+    static const int size = 64;
+    static const int tableCount = 2;
+    // half floats of one table
+    static const size_t tableLength = size * size * 4;
+
+    bool open(const std::string& path);
+
+    // size * size RGBA half floats, valid while the object lives
+    const uint16_t* table(int index) const;
+
+    // packs float tables of tableLength values each
+    static bool write(const std::string& path, const float* const tables[tableCount]);
+
+private:
+    MappedFile file;
+};
+#endif //GRAPHICS_PROGRAMMING_LTC_TABLES_H
@@ -0,0 +1,34 @@
+#ifndef GRAPHICS_PROGRAMMING_MAPPED_FILE_H
+#define GRAPHICS_PROGRAMMING_MAPPED_FILE_H
+
+#include <string>
+#include <cstddef>
+
+// Read-only memory mapping of a whole file.
+// The mapping stays valid until the object is destroyed.
+class MappedFile
+{
+public:
+    MappedFile() = default;
+    explicit MappedFile(const std::string& path);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool open(const std::string& path);
+    void close();
+
+    bool isOpen() const { return fileData != nullptr; }
+    const unsigned char* data() const { return fileData; }
+    size_t size() const { return fileSize; }
+
+private:
+    const unsigned char* fileData = nullptr;
+    size_t fileSize = 0;
+#ifdef _WIN32
+    void* fileHandle = nullptr;
+    void* mappingHandle = nullptr;
+#endif
+};
+#endif //GRAPHICS_PROGRAMMING_MAPPED_FILE_H
@@ -0,0 +1,763 @@
+#include "MeshOptimizer.h"
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "glm/glm.hpp"
+
+namespace {
+    const unsigned int forsythCacheSize = 32;
+
+    // Forsyth, "Linear-Speed Vertex Cache Optimisation"
+    float vertexScore(int cachePosition, unsigned int liveTriangles) {
+        if (liveTriangles == 0)
+            return -1.0f;
+        float score = 0.0f;
+        if (cachePosition >= 0) {
+            // the triangle just drawn used the first three entries, reusing them right away gains nothing extra
+            if (cachePosition < 3)
+                score = 0.75f;
+            else
+                score = std::pow(1.0f - (float) (cachePosition - 3) / (forsythCacheSize - 3), 1.5f);
+        }
+        // favour vertices with few triangles left so they leave the working set early
+        return score + 2.0f / std::sqrt((float) liveTriangles);
+    }
+
+    // FIFO cache simulation, a vertex hits while fewer than cacheSize misses happened since it was inserted
+    class FifoCache
+    {
+    public:
+        FifoCache(size_t vertexCount, unsigned int cacheSize)
+                : timestamps(vertexCount, 0), cacheSize(cacheSize), time(cacheSize + 1) {}
+
+        unsigned int triangleMisses(const unsigned int* triangle) {
+            unsigned int misses = 0;
+            for (int k = 0; k < 3; k++) {
+                unsigned int v = triangle[k];
+                if (time - timestamps[v] > cacheSize) {
+                    timestamps[v] = time++;
+                    misses++;
+                }
+            }
+            return misses;
+        }
+
+        void reset() { time += cacheSize + 1; }
+
+    private:
+        std::vector<unsigned int> timestamps;
+        unsigned int cacheSize;
+        unsigned int time;
+    };
+
+    // symmetric 4x4 error quadric of a set of planes, stored as its upper triangle
+    struct Quadric {
+        float a00 = 0, a11 = 0, a22 = 0, a01 = 0, a02 = 0, a12 = 0;
+        float b0 = 0, b1 = 0, b2 = 0, c = 0;
+        float weight = 0;   // total of the plane weights, error is divided by it
+
+        static Quadric plane(const glm::vec3 &normal, float distance, float weight) {
+            Quadric q;
+            q.a00 = weight * normal.x * normal.x;
+            q.a11 = weight * normal.y * normal.y;
+            q.a22 = weight * normal.z * normal.z;
+            q.a01 = weight * normal.x * normal.y;
+            q.a02 = weight * normal.x * normal.z;
+            q.a12 = weight * normal.y * normal.z;
+            q.b0 = weight * normal.x * distance;
+            q.b1 = weight * normal.y * distance;
+            q.b2 = weight * normal.z * distance;
+            q.c = weight * distance * distance;
+            q.weight = weight;
+            return q;
+        }
+
+        Quadric &operator+=(const Quadric &q) {
+            a00 += q.a00; a11 += q.a11; a22 += q.a22;
+            a01 += q.a01; a02 += q.a02; a12 += q.a12;
+            b0 += q.b0; b1 += q.b1; b2 += q.b2;
+            c += q.c;
+            weight += q.weight;
+            return *this;
+        }
+
+        // weighted mean of the squared distances of p to the planes, a squared distance in the planes' space
+        float error(const glm::vec3 &p) const {
+            if (weight <= 0.0f)
+                return 0.0f;
+            float rx = a00 * p.x + a01 * p.y + a02 * p.z + b0;
+            float ry = a01 * p.x + a11 * p.y + a12 * p.z + b1;
+            float rz = a02 * p.x + a12 * p.y + a22 * p.z + b2;
+            return std::abs(p.x * rx + p.y * ry + p.z * rz + b0 * p.x + b1 * p.y + b2 * p.z + c) / weight;
+        }
+    };
+
+    enum VertexKind : unsigned char {
+        Manifold,   // interior vertex, collapses towards any neighbour
+        Border,     // on an open edge, collapses along the border only
+        Locked      // seam or non manifold, never removed
+    };
+
+    uint64_t edgeKey(unsigned int a, unsigned int b) {
+        return ((uint64_t) a << 32) | b;
+    }
+
+    struct Collapse {
+        unsigned int from;
+        unsigned int to;
+        float cost;
+    };
+
+    // bounding sphere, box and normal cone of the triangles of one cluster
+    void meshletBounds(MeshOptimizer::Meshlet &meshlet, const unsigned int *indices, const std::vector<float> &vertices,
+                       unsigned int vertexSize) {
+        glm::vec3 lower(std::numeric_limits<float>::max()), upper(-std::numeric_limits<float>::max());
+        glm::vec3 normalSum(0.0f);
+        std::vector<glm::vec3> normals;
+        normals.reserve(meshlet.triangleCount);
+        for (unsigned int i = 0; i < meshlet.triangleCount * 3; i += 3) {
+            glm::vec3 p[3];
+            for (int k = 0; k < 3; k++) {
+                p[k] = glm::vec3(vertices[(size_t) indices[i + k] * vertexSize],
+                                 vertices[(size_t) indices[i + k] * vertexSize + 1],
+                                 vertices[(size_t) indices[i + k] * vertexSize + 2]);
+                lower = glm::min(lower, p[k]);
+                upper = glm::max(upper, p[k]);
+            }
+            glm::vec3 normal = glm::cross(p[1] - p[0], p[2] - p[0]);
+            float length = glm::length(normal);
+            // degenerate triangles are never visible, so they do not widen the cone
+            if (length > 0.0f) {
+                normals.push_back(normal / length);
+                normalSum += normals.back();
+            }
+        }
+
+        glm::vec3 center = (lower + upper) * 0.5f;
+        float radius = 0.0f;
+        for (unsigned int i = 0; i < meshlet.triangleCount * 3; i++) {
+            const float *p = &vertices[(size_t) indices[i] * vertexSize];
+            radius = std::max(radius, glm::length(glm::vec3(p[0], p[1], p[2]) - center));
+        }
+
+        float axisLength = glm::length(normalSum);
+        glm::vec3 axis = axisLength > 0.0f ? normalSum / axisLength : glm::vec3(0.0f, 0.0f, 1.0f);
+        float minDot = axisLength > 0.0f ? 1.0f : -1.0f;
+        for (auto &normal: normals)
+            minDot = std::min(minDot, glm::dot(normal, axis));
+        // past ~84 degrees the cone would only cull from grazing angles
+        float cutoff = minDot <= 0.1f ? 1.0f : std::sqrt(1.0f - minDot * minDot);
+
+        for (int k = 0; k < 3; k++) {
+            meshlet.center[k] = center[k];
+            meshlet.boundsMin[k] = lower[k];
+            meshlet.boundsMax[k] = upper[k];
+            meshlet.coneAxis[k] = axis[k];
+        }
+        meshlet.radius = radius;
+        meshlet.coneCutoff = cutoff;
+    }
+}
+
+MeshOptimizer::CacheStats MeshOptimizer::analyzeVertexCache(const std::vector<unsigned int> &indices, size_t vertexCount,
+                                                            unsigned int cacheSize) {
+    CacheStats stats;
+    size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0)
+        return stats;
+
+    FifoCache cache(vertexCount, cacheSize);
+    std::vector<bool> referenced(vertexCount, false);
+    size_t misses = 0;
+    size_t uniqueVertices = 0;
+    for (size_t i = 0; i < triangleCount; i++) {
+        misses += cache.triangleMisses(&indices[i * 3]);
+        for (int k = 0; k < 3; k++) {
+            if (!referenced[indices[i * 3 + k]]) {
+                referenced[indices[i * 3 + k]] = true;
+                uniqueVertices++;
+            }
+        }
+    }
+    stats.acmr = (float) misses / (float) triangleCount;
+    stats.atvr = (float) misses / (float) uniqueVertices;
+    return stats;
+}
+
+void MeshOptimizer::optimizeVertexCache(std::vector<unsigned int> &indices, size_t vertexCount) {
+    size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0)
+        return;
+
+    // vertex to triangle adjacency, the live triangles of vertex v are the first liveTriangles[v] entries
+    std::vector<unsigned int> liveTriangles(vertexCount, 0);
+    for (unsigned int index: indices)
+        liveTriangles[index]++;
+    std::vector<unsigned int> adjacencyOffsets(vertexCount + 1, 0);
+    for (size_t v = 0; v < vertexCount; v++)
+        adjacencyOffsets[v + 1] = adjacencyOffsets[v] + liveTriangles[v];
+    std::vector<unsigned int> adjacency(indices.size());
+    std::vector<unsigned int> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+    for (size_t i = 0; i < indices.size(); i++)
+        adjacency[fill[indices[i]]++] = (unsigned int) (i / 3);
+
+    std::vector<int> cachePositions(vertexCount, -1);
+    std::vector<float> scores(vertexCount);
+    for (size_t v = 0; v < vertexCount; v++)
+        scores[v] = vertexScore(-1, liveTriangles[v]);
+
+    std::vector<bool> emitted(triangleCount, false);
+    std::vector<unsigned int> cache, nextCache;
+    cache.reserve(forsythCacheSize + 3);
+    nextCache.reserve(forsythCacheSize + 3);
+    std::vector<unsigned int> result;
+    result.reserve(indices.size());
+
+    size_t cursor = 0;
+    long long best = -1;
+    for (size_t emittedCount = 0; emittedCount < triangleCount; emittedCount++) {
+        // nothing in the cache has work left, continue with the next triangle in input order
+        if (best < 0) {
+            while (emitted[cursor])
+                cursor++;
+            best = (long long) cursor;
+        }
+
+        const unsigned int *triangle = &indices[best * 3];
+        emitted[best] = true;
+        result.insert(result.end(), triangle, triangle + 3);
+
+        nextCache.assign(triangle, triangle + 3);
+        for (int k = 0; k < 3; k++) {
+            unsigned int v = triangle[k];
+            unsigned int *begin = &adjacency[adjacencyOffsets[v]];
+            unsigned int *end = begin + liveTriangles[v];
+            std::iter_swap(std::find(begin, end, (unsigned int) best), end - 1);
+            liveTriangles[v]--;
+        }
+        for (unsigned int v: cache) {
+            if (v != triangle[0] && v != triangle[1] && v != triangle[2])
+                nextCache.push_back(v);
+        }
+        // anything pushed past the end is evicted
+        for (size_t i = forsythCacheSize; i < nextCache.size(); i++) {
+            cachePositions[nextCache[i]] = -1;
+            scores[nextCache[i]] = vertexScore(-1, liveTriangles[nextCache[i]]);
+        }
+        if (nextCache.size() > forsythCacheSize)
+            nextCache.resize(forsythCacheSize);
+        cache.swap(nextCache);
+
+        for (size_t i = 0; i < cache.size(); i++) {
+            cachePositions[cache[i]] = (int) i;
+            scores[cache[i]] = vertexScore((int) i, liveTriangles[cache[i]]);
+        }
+
+        // only triangles touching the cache changed score, the best of them is drawn next
+        best = -1;
+        float bestScore = 0.0f;
+        for (unsigned int v: cache) {
+            for (unsigned int a = 0; a < liveTriangles[v]; a++) {
+                unsigned int t = adjacency[adjacencyOffsets[v] + a];
+                float score = scores[indices[t * 3]] + scores[indices[t * 3 + 1]] + scores[indices[t * 3 + 2]];
+                if (score > bestScore) {
+                    bestScore = score;
+                    best = t;
+                }
+            }
+        }
+    }
+    indices.swap(result);
+}
+
+void MeshOptimizer::optimizeOverdraw(std::vector<unsigned int> &indices, const std::vector<float> &vertices,
+                                     unsigned int vertexSize, float threshold) {
+    size_t triangleCount = indices.size() / 3;
+    size_t vertexCount = vertices.size() / vertexSize;
+    if (triangleCount < 2)
+        return;
+
+    // Sander et al., "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw".
+    // A triangle with three misses starts a new cache run, so splitting there costs nothing.
+    std::vector<size_t> clusters;
+    {
+        FifoCache cache(vertexCount, analysisCacheSize);
+        for (size_t i = 0; i < triangleCount; i++) {
+            if (cache.triangleMisses(&indices[i * 3]) == 3)
+                clusters.push_back(i);
+        }
+    }
+
+    // runs are split further where the local ACMR already reached the run's average times threshold
+    std::vector<size_t> softClusters;
+    FifoCache cache(vertexCount, analysisCacheSize);
+    for (size_t c = 0; c < clusters.size(); c++) {
+        size_t start = clusters[c];
+        size_t end = c + 1 < clusters.size() ? clusters[c + 1] : triangleCount;
+
+        cache.reset();
+        size_t clusterMisses = 0;
+        for (size_t i = start; i < end; i++)
+            clusterMisses += cache.triangleMisses(&indices[i * 3]);
+        float clusterThreshold = threshold * (float) clusterMisses / (float) (end - start);
+
+        cache.reset();
+        softClusters.push_back(start);
+        size_t misses = 0, faces = 0;
+        for (size_t i = start; i < end; i++) {
+            misses += cache.triangleMisses(&indices[i * 3]);
+            faces++;
+            if (i + 1 < end && (float) misses / (float) faces <= clusterThreshold) {
+                softClusters.push_back(i + 1);
+                cache.reset();
+                misses = 0;
+                faces = 0;
+            }
+        }
+    }
+
+    // area weighted centroid and normal of every cluster
+    size_t clusterCount = softClusters.size();
+    std::vector<glm::vec3> centroids(clusterCount, glm::vec3(0.0f));
+    std::vector<glm::vec3> normals(clusterCount, glm::vec3(0.0f));
+    std::vector<float> areas(clusterCount, 0.0f);
+    glm::vec3 meshCentroid(0.0f);
+    float meshArea = 0.0f;
+    for (size_t c = 0; c < clusterCount; c++) {
+        size_t end = c + 1 < clusterCount ? softClusters[c + 1] : triangleCount;
+        for (size_t i = softClusters[c]; i < end; i++) {
+            const float *p0 = &vertices[indices[i * 3] * vertexSize];
+            const float *p1 = &vertices[indices[i * 3 + 1] * vertexSize];
+            const float *p2 = &vertices[indices[i * 3 + 2] * vertexSize];
+            glm::vec3 a(p0[0], p0[1], p0[2]), b(p1[0], p1[1], p1[2]), d(p2[0], p2[1], p2[2]);
+            glm::vec3 normal = glm::cross(b - a, d - a);
+            float area = glm::length(normal);
+            centroids[c] += (a + b + d) * (area / 3.0f);
+            normals[c] += normal;
+            areas[c] += area;
+        }
+        meshCentroid += centroids[c];
+        meshArea += areas[c];
+        if (areas[c] > 0.0f)
+            centroids[c] /= areas[c];
+    }
+    if (meshArea > 0.0f)
+        meshCentroid /= meshArea;
+
+    // clusters facing away from the middle of the mesh tend to occlude the rest, draw them first
+    std::vector<float> sortKeys(clusterCount);
+    for (size_t c = 0; c < clusterCount; c++) {
+        float length = glm::length(normals[c]);
+        sortKeys[c] = length > 0.0f ? glm::dot(centroids[c] - meshCentroid, normals[c] / length) : 0.0f;
+    }
+    std::vector<size_t> order(clusterCount);
+    for (size_t c = 0; c < clusterCount; c++)
+        order[c] = c;
+    std::stable_sort(order.begin(), order.end(), [&sortKeys](size_t a, size_t b) { return sortKeys[a] > sortKeys[b]; });
+
+    std::vector<unsigned int> result;
+    result.reserve(indices.size());
+    for (size_t c: order) {
+        size_t end = c + 1 < clusterCount ? softClusters[c + 1] : triangleCount;
+        result.insert(result.end(), indices.begin() + softClusters[c] * 3, indices.begin() + end * 3);
+    }
+    indices.swap(result);
+}
+
+std::vector<unsigned int> MeshOptimizer::simplify(const std::vector<unsigned int> &indices,
+                                                 const std::vector<float> &vertices, unsigned int vertexSize,
+                                                 size_t targetIndexCount, float targetError,
+                                                 float attributeWeight, float *resultError) {
+    size_t vertexCount = vertices.size() / vertexSize;
+    std::vector<unsigned int> result = indices;
+    if (resultError)
+        *resultError = 0.0f;
+    if (result.size() <= targetIndexCount || vertexCount == 0)
+        return result;
+
+    // errors are measured on positions scaled into the unit cube, so targetError is scale independent
+    glm::vec3 lower(vertices[0], vertices[1], vertices[2]), upper = lower;
+    for (size_t v = 0; v < vertexCount; v++) {
+        glm::vec3 p(vertices[v * vertexSize], vertices[v * vertexSize + 1], vertices[v * vertexSize + 2]);
+        lower = glm::min(lower, p);
+        upper = glm::max(upper, p);
+    }
+    float extent = std::max(std::max(upper.x - lower.x, upper.y - lower.y), upper.z - lower.z);
+    if (extent <= 0.0f)
+        return result;
+    std::vector<glm::vec3> positions(vertexCount);
+    for (size_t v = 0; v < vertexCount; v++) {
+        glm::vec3 p(vertices[v * vertexSize], vertices[v * vertexSize + 1], vertices[v * vertexSize + 2]);
+        positions[v] = (p - lower) / extent;
+    }
+
+    // vertices sharing a position but not their attributes form a seam, the first one represents the position
+    std::vector<unsigned int> wedge(vertexCount);
+    std::vector<unsigned int> wedgeCount(vertexCount, 0);
+    {
+        std::unordered_map<uint64_t, unsigned int> firstAtPosition;
+        firstAtPosition.reserve(vertexCount);
+        for (size_t v = 0; v < vertexCount; v++) {
+            uint32_t bits[3];
+            memcpy(bits, &vertices[v * vertexSize], sizeof(bits));
+            uint64_t hash = ((uint64_t) bits[0] * 73856093u) ^ ((uint64_t) bits[1] * 19349663u << 21) ^
+                            ((uint64_t) bits[2] * 83492791u << 42);
+            auto inserted = firstAtPosition.emplace(hash, (unsigned int) v);
+            unsigned int first = inserted.first->second;
+            // a hash collision with a different position is simply not treated as a seam
+            wedge[v] = positions[first] == positions[v] ? first : (unsigned int) v;
+            wedgeCount[wedge[v]]++;
+        }
+    }
+
+    std::vector<Quadric> quadrics(vertexCount);
+    for (size_t i = 0; i + 2 < result.size(); i += 3) {
+        const glm::vec3 &p0 = positions[result[i]], &p1 = positions[result[i + 1]], &p2 = positions[result[i + 2]];
+        glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+        float area = glm::length(normal);
+        if (area == 0.0f)
+            continue;
+        normal /= area;
+        Quadric q = Quadric::plane(normal, -glm::dot(normal, p0), area);
+        for (int k = 0; k < 3; k++)
+            quadrics[result[i + k]] += q;
+    }
+
+    unsigned int attributeCount = vertexSize > 3 ? vertexSize - 3 : 0;
+    auto collapseCost = [&](unsigned int from, unsigned int to) {
+        float cost = quadrics[from].error(positions[to]);
+        float attributeDistance = 0.0f;
+        for (unsigned int k = 0; k < attributeCount; k++) {
+            float d = vertices[from * vertexSize + 3 + k] - vertices[to * vertexSize + 3 + k];
+            attributeDistance += d * d;
+        }
+        return cost + attributeWeight * attributeWeight * attributeDistance;
+    };
+
+    float maxCost = 0.0f;
+    float targetCost = targetError * targetError;
+    std::vector<unsigned char> kinds(vertexCount);
+    std::vector<unsigned int> collapseTo(vertexCount);
+    std::vector<unsigned char> touched(vertexCount);
+    std::vector<unsigned int> adjacencyOffsets(vertexCount + 1);
+    std::vector<unsigned int> adjacency;
+    std::vector<Collapse> collapses;
+
+    while (result.size() > targetIndexCount) {
+        size_t triangleCount = result.size() / 3;
+
+        // classify against the current topology, edges are compared by position so seams are not borders
+        std::unordered_map<uint64_t, unsigned int> edgeUses;
+        edgeUses.reserve(result.size());
+        for (size_t i = 0; i < result.size(); i += 3) {
+            for (int k = 0; k < 3; k++)
+                edgeUses[edgeKey(wedge[result[i + k]], wedge[result[i + (k + 1) % 3]])]++;
+        }
+        for (size_t v = 0; v < vertexCount; v++)
+            kinds[v] = wedgeCount[wedge[v]] > 1 ? Locked : Manifold;
+        std::unordered_set<uint64_t> borderEdges;
+        std::vector<unsigned int> borderEdgeCount(vertexCount, 0);
+        for (size_t i = 0; i < result.size(); i += 3) {
+            for (int k = 0; k < 3; k++) {
+                unsigned int a = result[i + k], b = result[i + (k + 1) % 3];
+                unsigned int forward = edgeUses[edgeKey(wedge[a], wedge[b])];
+                auto reverse = edgeUses.find(edgeKey(wedge[b], wedge[a]));
+                unsigned int backward = reverse == edgeUses.end() ? 0 : reverse->second;
+                if (forward + backward > 2) {
+                    kinds[a] = kinds[b] = Locked;
+                } else if (backward == 0) {
+                    borderEdges.insert(edgeKey(a, b));
+                    borderEdges.insert(edgeKey(b, a));
+                    borderEdgeCount[a]++;
+                    borderEdgeCount[b]++;
+                }
+            }
+        }
+        for (size_t v = 0; v < vertexCount; v++) {
+            if (kinds[v] == Manifold && borderEdgeCount[v] > 0)
+                kinds[v] = borderEdgeCount[v] == 2 ? Border : Locked;
+        }
+
+        // vertex to triangle adjacency of the current index list
+        std::fill(adjacencyOffsets.begin(), adjacencyOffsets.end(), 0);
+        for (unsigned int index: result)
+            adjacencyOffsets[index + 1]++;
+        for (size_t v = 0; v < vertexCount; v++)
+            adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+        adjacency.resize(result.size());
+        std::vector<unsigned int> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+        for (size_t i = 0; i < result.size(); i++)
+            adjacency[fill[result[i]]++] = (unsigned int) (i / 3);
+
+        collapses.clear();
+        for (size_t i = 0; i < result.size(); i += 3) {
+            for (int k = 0; k < 3; k++) {
+                unsigned int a = result[i + k], b = result[i + (k + 1) % 3];
+                for (int direction = 0; direction < 2; direction++) {
+                    unsigned int from = direction ? b : a, to = direction ? a : b;
+                    if (kinds[from] == Locked)
+                        continue;
+                    if (kinds[from] == Border && borderEdges.count(edgeKey(from, to)) == 0)
+                        continue;
+                    collapses.push_back(Collapse{from, to, collapseCost(from, to)});
+                }
+            }
+        }
+        if (collapses.empty())
+            break;
+        std::sort(collapses.begin(), collapses.end(),
+                  [](const Collapse &x, const Collapse &y) { return x.cost < y.cost; });
+
+        // independent collapses only, every vertex around a changed fan waits for the next pass
+        size_t trianglesToRemove = (result.size() - targetIndexCount) / 3 + 1;
+        size_t removed = 0;
+        std::fill(touched.begin(), touched.end(), 0);
+        for (size_t v = 0; v < vertexCount; v++)
+            collapseTo[v] = (unsigned int) v;
+        for (const Collapse &collapse: collapses) {
+            if (collapse.cost > targetCost || removed >= trianglesToRemove)
+                break;
+            if (touched[collapse.from] || touched[collapse.to])
+                continue;
+
+            // reject collapses that fold a triangle over
+            bool flips = false;
+            for (unsigned int a = adjacencyOffsets[collapse.from]; a < adjacencyOffsets[collapse.from + 1]; a++) {
+                const unsigned int *triangle = &result[adjacency[a] * 3];
+                if (triangle[0] == collapse.to || triangle[1] == collapse.to || triangle[2] == collapse.to)
+                    continue;
+                glm::vec3 before[3], after[3];
+                for (int k = 0; k < 3; k++) {
+                    before[k] = positions[triangle[k]];
+                    after[k] = triangle[k] == collapse.from ? positions[collapse.to] : before[k];
+                }
+                glm::vec3 n0 = glm::cross(before[1] - before[0], before[2] - before[0]);
+                glm::vec3 n1 = glm::cross(after[1] - after[0], after[2] - after[0]);
+                if (glm::dot(n0, n1) <= 0.25f * glm::length(n0) * glm::length(n1)) {
+                    flips = true;
+                    break;
+                }
+            }
+            if (flips)
+                continue;
+
+            collapseTo[collapse.from] = collapse.to;
+            quadrics[collapse.to] += quadrics[collapse.from];
+            for (unsigned int a = adjacencyOffsets[collapse.from]; a < adjacencyOffsets[collapse.from + 1]; a++) {
+                const unsigned int *triangle = &result[adjacency[a] * 3];
+                touched[triangle[0]] = touched[triangle[1]] = touched[triangle[2]] = 1;
+            }
+            maxCost = std::max(maxCost, collapse.cost);
+            removed += kinds[collapse.from] == Border ? 1 : 2;
+        }
+        if (removed == 0)
+            break;
+
+        size_t write = 0;
+        for (size_t i = 0; i < triangleCount; i++) {
+            unsigned int a = collapseTo[result[i * 3]];
+            unsigned int b = collapseTo[result[i * 3 + 1]];
+            unsigned int c = collapseTo[result[i * 3 + 2]];
+            if (a == b || b == c || a == c)
+                continue;
+            result[write++] = a;
+            result[write++] = b;
+            result[write++] = c;
+        }
+        result.resize(write);
+    }
+
+    if (resultError)
+        *resultError = std::sqrt(maxCost) * extent;
+    return result;
+}
+
+std::vector<MeshOptimizer::Meshlet> MeshOptimizer::buildMeshlets(std::vector<unsigned int> &indices,
+                                                                 const std::vector<float> &vertices,
+                                                                 unsigned int vertexSize, unsigned int maxVertices,
+                                                                 unsigned int maxTriangles) {
+    size_t vertexCount = vertices.size() / vertexSize;
+    size_t triangleCount = indices.size() / 3;
+
+    // vertex to triangle adjacency
+    std::vector<unsigned int> adjacencyOffsets(vertexCount + 1, 0);
+    for (unsigned int index: indices)
+        adjacencyOffsets[index + 1]++;
+    for (size_t v = 0; v < vertexCount; v++)
+        adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+    std::vector<unsigned int> adjacency(indices.size());
+    {
+        std::vector<unsigned int> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+        for (size_t i = 0; i < indices.size(); i++)
+            adjacency[fill[indices[i]]++] = (unsigned int) (i / 3);
+    }
+
+    std::vector<glm::vec3> centroids(triangleCount);
+    for (size_t t = 0; t < triangleCount; t++) {
+        glm::vec3 sum(0.0f);
+        for (int k = 0; k < 3; k++) {
+            const float *p = &vertices[(size_t) indices[t * 3 + k] * vertexSize];
+            sum += glm::vec3(p[0], p[1], p[2]);
+        }
+        centroids[t] = sum / 3.0f;
+    }
+
+    std::vector<bool> emitted(triangleCount, false);
+    // meshlet number + 1 of the cluster a vertex was last added to
+    std::vector<unsigned int> vertexMeshlet(vertexCount, 0);
+    std::vector<unsigned int> result;
+    result.reserve(indices.size());
+    std::vector<Meshlet> meshlets;
+    std::vector<unsigned int> triangles, meshletVertices;
+    size_t scan = 0;
+
+    while (result.size() < indices.size()) {
+        unsigned int stamp = (unsigned int) meshlets.size() + 1;
+        triangles.clear();
+        meshletVertices.clear();
+        glm::vec3 centroidSum(0.0f);
+
+        auto newVertices = [&](size_t t) {
+            unsigned int count = 0;
+            for (int k = 0; k < 3; k++)
+                count += vertexMeshlet[indices[t * 3 + k]] != stamp;
+            return count;
+        };
+        auto add = [&](size_t t) {
+            emitted[t] = true;
+            triangles.push_back((unsigned int) t);
+            centroidSum += centroids[t];
+            for (int k = 0; k < 3; k++) {
+                unsigned int v = indices[t * 3 + k];
+                if (vertexMeshlet[v] != stamp) {
+                    vertexMeshlet[v] = stamp;
+                    meshletVertices.push_back(v);
+                }
+            }
+        };
+
+        while (emitted[scan])
+            scan++;
+        add(scan);
+
+        while (triangles.size() < maxTriangles) {
+            // prefer the neighbour adding the fewest vertices, then the one closest to the cluster centre
+            glm::vec3 centroid = centroidSum / (float) triangles.size();
+            size_t best = triangleCount;
+            unsigned int bestExtra = 3;
+            float bestDistance = std::numeric_limits<float>::max();
+            for (unsigned int v: meshletVertices) {
+                for (unsigned int a = adjacencyOffsets[v]; a < adjacencyOffsets[v + 1]; a++) {
+                    unsigned int t = adjacency[a];
+                    if (emitted[t])
+                        continue;
+                    unsigned int extra = newVertices(t);
+                    if (meshletVertices.size() + extra > maxVertices || extra > bestExtra)
+                        continue;
+                    glm::vec3 offset = centroids[t] - centroid;
+                    float distance = glm::dot(offset, offset);
+                    if (extra < bestExtra || distance < bestDistance) {
+                        best = t;
+                        bestExtra = extra;
+                        bestDistance = distance;
+                    }
+                }
+            }
+            // a disconnected piece continues with the next triangle in the original order, which the vertex
+            // cache optimization already left close by
+            if (best == triangleCount) {
+                while (scan < triangleCount && emitted[scan])
+                    scan++;
+                if (scan == triangleCount || meshletVertices.size() + newVertices(scan) > maxVertices)
+                    break;
+                best = scan;
+            }
+            add(best);
+        }
+
+        // keep the incoming order inside a cluster, it is what the vertex cache was optimized for
+        std::sort(triangles.begin(), triangles.end());
+        Meshlet meshlet{};
+        meshlet.indexOffset = (unsigned int) result.size();
+        meshlet.triangleCount = (unsigned int) triangles.size();
+        for (unsigned int t: triangles)
+            result.insert(result.end(), indices.begin() + t * 3, indices.begin() + t * 3 + 3);
+        meshletBounds(meshlet, &result[meshlet.indexOffset], vertices, vertexSize);
+        meshlets.push_back(meshlet);
+    }
+
+    // Growing clusters discards the cluster order of optimizeOverdraw, so the finished meshlets get the same
+    // outward first sort: area weighted centroid offset from the mesh centroid along the cluster normal.
+    size_t meshletCount = meshlets.size();
+    std::vector<glm::vec3> meshletCentroids(meshletCount, glm::vec3(0.0f));
+    std::vector<glm::vec3> meshletNormals(meshletCount, glm::vec3(0.0f));
+    glm::vec3 meshCentroid(0.0f);
+    float meshArea = 0.0f;
+    for (size_t m = 0; m < meshletCount; m++) {
+        float area = 0.0f;
+        for (unsigned int i = 0; i < meshlets[m].triangleCount * 3; i += 3) {
+            const float *p0 = &vertices[(size_t) result[meshlets[m].indexOffset + i] * vertexSize];
+            const float *p1 = &vertices[(size_t) result[meshlets[m].indexOffset + i + 1] * vertexSize];
+            const float *p2 = &vertices[(size_t) result[meshlets[m].indexOffset + i + 2] * vertexSize];
+            glm::vec3 a(p0[0], p0[1], p0[2]), b(p1[0], p1[1], p1[2]), d(p2[0], p2[1], p2[2]);
+            glm::vec3 normal = glm::cross(b - a, d - a);
+            float triangleArea = glm::length(normal);
+            meshletCentroids[m] += (a + b + d) * (triangleArea / 3.0f);
+            meshletNormals[m] += normal;
+            area += triangleArea;
+        }
+        meshCentroid += meshletCentroids[m];
+        meshArea += area;
+        if (area > 0.0f)
+            meshletCentroids[m] /= area;
+    }
+    if (meshArea > 0.0f)
+        meshCentroid /= meshArea;
+
+    std::vector<float> sortKeys(meshletCount);
+    for (size_t m = 0; m < meshletCount; m++) {
+        float length = glm::length(meshletNormals[m]);
+        sortKeys[m] = length > 0.0f ? glm::dot(meshletCentroids[m] - meshCentroid, meshletNormals[m] / length) : 0.0f;
+    }
+    std::vector<size_t> order(meshletCount);
+    for (size_t m = 0; m < meshletCount; m++)
+        order[m] = m;
+    std::stable_sort(order.begin(), order.end(), [&sortKeys](size_t a, size_t b) { return sortKeys[a] > sortKeys[b]; });
+
+    indices.clear();
+    std::vector<Meshlet> sorted;
+    sorted.reserve(meshletCount);
+    for (size_t m: order) {
+        Meshlet meshlet = meshlets[m];
+        auto first = result.begin() + meshlet.indexOffset;
+        meshlet.indexOffset = (unsigned int) indices.size();
+        indices.insert(indices.end(), first, first + meshlet.triangleCount * 3);
+        sorted.push_back(meshlet);
+    }
+    return sorted;
+}
+
+size_t MeshOptimizer::optimizeVertexFetch(std::vector<float> &vertices, std::vector<unsigned int> &indices,
+                                          unsigned int vertexSize) {
+    size_t vertexCount = vertices.size() / vertexSize;
+    std::vector<unsigned int> remap(vertexCount, ~0u);
+    std::vector<float> result;
+    result.reserve(vertices.size());
+    unsigned int next = 0;
+    for (unsigned int &index: indices) {
+        if (remap[index] == ~0u) {
+            remap[index] = next++;
+            result.insert(result.end(), vertices.begin() + (size_t) index * vertexSize,
+                          vertices.begin() + (size_t) (index + 1) * vertexSize);
+        }
+        index = remap[index];
+    }
+    vertices.swap(result);
+    return next;
+}
@@ -0,0 +1,67 @@
+#ifndef GRAPHICS_PROGRAMMING_MESH_OPTIMIZER_H
+#define GRAPHICS_PROGRAMMING_MESH_OPTIMIZER_H
+
+#include <vector>
+#include <cstddef>
+
+// Load time reordering of indexed triangle lists.
+// Vertices are interleaved floats with the position in the first three components.
+// Every function is CPU only and safe to run on a ThreadPool worker.
+class MeshOptimizer
+{
+public:
+    // FIFO size used to report cache efficiency, close to what current GPUs reuse in practice
+    static const unsigned int analysisCacheSize = 16;
+
+    struct CacheStats {
+        float acmr = 0.0f;  // transformed vertices per triangle, 0.5 is ideal for a regular grid
+        float atvr = 0.0f;  // transformed vertices per unique vertex, 1.0 is ideal
+    };
+
+    static CacheStats analyzeVertexCache(const std::vector<unsigned int>& indices, size_t vertexCount,
+                                         unsigned int cacheSize = analysisCacheSize);
+
+    // reorders triangles for the post-transform cache (Forsyth, simulated 32 entry LRU)
+    static void optimizeVertexCache(std::vector<unsigned int>& indices, size_t vertexCount);
+
+    // Groups a cache optimized index list into clusters and sorts them so outward facing ones come first.
+    // threshold bounds how much ACMR may be traded for overdraw, 1.05 allows 5% more vertex shading.
+    static void optimizeOverdraw(std::vector<unsigned int>& indices, const std::vector<float>& vertices,
+                                 unsigned int vertexSize, float threshold = 1.05f);
+
+    // Quadric error edge collapse (Garland and Heckbert) towards targetIndexCount, stopping early once a
+    // collapse would exceed targetError, given relative to the mesh extent. Vertices on attribute seams and
+    // non manifold edges stay put, border vertices only slide along the border, and attributeWeight adds the
+    // normal/uv difference to the cost. The returned indices refer to the same vertices, resultError receives
+    // the largest error in position units.
+    static std::vector<unsigned int> simplify(const std::vector<unsigned int>& indices,
+                                              const std::vector<float>& vertices, unsigned int vertexSize,
+                                              size_t targetIndexCount, float targetError,
+                                              float attributeWeight = 0.01f, float* resultError = nullptr);
+
+    // One cluster of an index range, laid out as four vec4 so the records can go straight into a std430 buffer.
+    // The cluster is entirely backfacing from eye when
+    // dot(center - eye, coneAxis) >= coneCutoff * length(center - eye) + radius.
+    struct Meshlet {
+        float center[3];
+        float radius;
+        float boundsMin[3];
+        unsigned int indexOffset;   // first index, relative to the indices given to buildMeshlets
+        float boundsMax[3];
+        unsigned int triangleCount;
+        float coneAxis[3];
+        float coneCutoff;           // sine of the normal cone half angle, 1 when the cone is too wide to cull
+    };
+
+    // Reorders the triangles into clusters of at most maxVertices unique vertices and maxTriangles triangles.
+    // Clusters grow over shared edges, so they stay compact and can be culled on their own.
+    // The clusters are then sorted outward facing first, the same order optimizeOverdraw gives its clusters.
+    static std::vector<Meshlet> buildMeshlets(std::vector<unsigned int>& indices, const std::vector<float>& vertices,
+                                              unsigned int vertexSize, unsigned int maxVertices = 64,
+                                              unsigned int maxTriangles = 124);
+
+    // Renumbers vertices in order of first use, dropping unreferenced ones. Returns the new vertex count.
+    static size_t optimizeVertexFetch(std::vector<float>& vertices, std::vector<unsigned int>& indices,
+                                      unsigned int vertexSize);
+};
+#endif //GRAPHICS_PROGRAMMING_MESH_OPTIMIZER_H
@@ -0,0 +1,185 @@
+#include "MipGenerator.h"
+#include "ThreadPool.h"
+
+#include <cmath>
+#include <algorithm>
+
+namespace {
+    const float kernelRadius = 2.0f;    // in destination texels, 4 source texels either side of a 2:1 step
+    const float kaiserBeta = 4.0f;
+    const float pi = 3.14159265358979f;
+
+    // zeroth order modified Bessel function of the first kind, by its power series
+    float besselI0(float x) {
+        float sum = 1.0f, term = 1.0f;
+        for (int k = 1; k < 20; k++) {
+            term *= (x / (2.0f * (float) k)) * (x / (2.0f * (float) k));
+            sum += term;
+        }
+        return sum;
+    }
+
+    float kernel(float t) {
+        if (std::abs(t) >= kernelRadius)
+            return 0.0f;
+        float sinc = t == 0.0f ? 1.0f : std::sin(pi * t) / (pi * t);
+        float ratio = t / kernelRadius;
+        return sinc * besselI0(kaiserBeta * std::sqrt(1.0f - ratio * ratio)) / besselI0(kaiserBeta);
+    }
+
+    // normalized taps of every destination texel along one axis, source indices clamp at the edges
+    struct Taps {
+        std::vector<int> first;
+        std::vector<int> count;
+        std::vector<float> weights;     // count[i] consecutive entries per destination texel
+        std::vector<int> offsets;
+    };
+
+    Taps buildTaps(int sourceSize, int destinationSize) {
+        Taps taps;
+        float scale = (float) sourceSize / (float) destinationSize;
+        for (int i = 0; i < destinationSize; i++) {
+            taps.first.push_back(0);
+            taps.offsets.push_back((int) taps.weights.size());
+            // an axis that keeps its size is copied through
+            if (sourceSize == destinationSize) {
+                taps.first.back() = i;
+                taps.count.push_back(1);
+                taps.weights.push_back(1.0f);
+                continue;
+            }
+            float center = ((float) i + 0.5f) * scale;
+            int first = (int) std::floor(center - kernelRadius * scale);
+            int last = (int) std::ceil(center + kernelRadius * scale);
+            taps.first.back() = first;
+            float sum = 0.0f;
+            for (int s = first; s <= last; s++) {
+                float weight = kernel(((float) s + 0.5f - center) / scale);
+                taps.weights.push_back(weight);
+                sum += weight;
+            }
+            for (int s = first; s <= last; s++)
+                taps.weights[taps.offsets.back() + s - first] /= sum;
+            taps.count.push_back(last - first + 1);
+        }
+        return taps;
+    }
+
+    struct Conversion {
+        float toLinear[256];
+        float toUnit[256];
+        float toSigned[256];
+
+        Conversion() {
+            for (int i = 0; i < 256; i++) {
+                float c = (float) i / 255.0f;
+                toLinear[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+                toUnit[i] = c;
+                toSigned[i] = c * 2.0f - 1.0f;
+            }
+        }
+    };
+
+    const Conversion &conversion() {
+        static const Conversion table;
+        return table;
+    }
+
+    unsigned char toByte(float value) {
+        return (unsigned char) std::lround(std::min(std::max(value, 0.0f), 1.0f) * 255.0f);
+    }
+
+    unsigned char linearToSrgb(float value) {
+        value = std::min(std::max(value, 0.0f), 1.0f);
+        return toByte(value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f);
+    }
+
+    float alphaCoverage(const std::vector<unsigned char> &rgba, float cutoff, float scale) {
+        size_t passing = 0;
+        for (size_t i = 3; i < rgba.size(); i += 4)
+            passing += (float) rgba[i] / 255.0f * scale >= cutoff;
+        return (float) passing / (float) (rgba.size() / 4);
+    }
+
+    // Castano, binary search for the alpha scale that matches the coverage of level 0
+    void preserveCoverage(std::vector<unsigned char> &rgba, float cutoff, float coverage) {
+        float lower = 0.0f, upper = 4.0f, scale = 1.0f;
+        for (int iteration = 0; iteration < 12; iteration++) {
+            scale = (lower + upper) * 0.5f;
+            if (alphaCoverage(rgba, cutoff, scale) < coverage)
+                lower = scale;
+            else
+                upper = scale;
+        }
+        for (size_t i = 3; i < rgba.size(); i += 4)
+            rgba[i] = toByte((float) rgba[i] / 255.0f * scale);
+    }
+}
+
+MipGenerator::Level MipGenerator::downsample(const Level &source, Content content) {
+    Level result;
+    result.width = std::max(source.width / 2, 1);
+    result.height = std::max(source.height / 2, 1);
+    result.rgba.resize((size_t) result.width * result.height * 4);
+
+    Taps columns = buildTaps(source.width, result.width);
+    Taps rows = buildTaps(source.height, result.height);
+    const float *decode = content == Content::Color ? conversion().toLinear : conversion().toSigned;
+    const float *decodeAlpha = conversion().toUnit;
+
+    ThreadPool::shared().parallelFor((size_t) result.height, [&](size_t y) {
+        // vertical pass into one full width row of floats, then the horizontal pass out of it
+        std::vector<float> column((size_t) source.width * 4, 0.0f);
+        for (int t = 0; t < rows.count[y]; t++) {
+            int sourceRow = std::min(std::max(rows.first[y] + t, 0), source.height - 1);
+            float weight = rows.weights[rows.offsets[y] + t];
+            const unsigned char *row = source.rgba.data() + (size_t) sourceRow * source.width * 4;
+            float *out = column.data();
+            for (int x = 0; x < source.width * 4; x += 4) {
+                out[x] += decode[row[x]] * weight;
+                out[x + 1] += decode[row[x + 1]] * weight;
+                out[x + 2] += decode[row[x + 2]] * weight;
+                out[x + 3] += decodeAlpha[row[x + 3]] * weight;
+            }
+        }
+
+        unsigned char *destination = result.rgba.data() + y * result.width * 4;
+        for (int x = 0; x < result.width; x++) {
+            float texel[4] = {};
+            for (int t = 0; t < columns.count[x]; t++) {
+                int sourceColumn = std::min(std::max(columns.first[x] + t, 0), source.width - 1);
+                float weight = columns.weights[columns.offsets[x] + t];
+                for (int c = 0; c < 4; c++)
+                    texel[c] += column[(size_t) sourceColumn * 4 + c] * weight;
+            }
+            if (content == Content::NormalMap) {
+                float length = std::sqrt(texel[0] * texel[0] + texel[1] * texel[1] + texel[2] * texel[2]);
+                if (length < 1e-6f) {
+                    texel[0] = texel[1] = 0.0f;
+                    texel[2] = length = 1.0f;
+                }
+                for (int c = 0; c < 3; c++)
+                    destination[x * 4 + c] = toByte(texel[c] / length * 0.5f + 0.5f);
+            } else {
+                for (int c = 0; c < 3; c++)
+                    destination[x * 4 + c] = linearToSrgb(texel[c]);
+            }
+            destination[x * 4 + 3] = toByte(texel[3]);
+        }
+    });
+    return result;
+}
+
+std::vector<MipGenerator::Level> MipGenerator::generate(const unsigned char *rgba, int width, int height,
+                                                        Content content, float alphaCutoff) {
+    std::vector<Level> levels;
+    levels.push_back(Level{width, height, std::vector<unsigned char>(rgba, rgba + (size_t) width * height * 4)});
+    float coverage = alphaCutoff > 0.0f ? alphaCoverage(levels[0].rgba, alphaCutoff, 1.0f) : 0.0f;
+    while (levels.back().width > 1 || levels.back().height > 1) {
+        Level level = downsample(levels.back(), content);
+        if (alphaCutoff > 0.0f)
+            preserveCoverage(level.rgba, alphaCutoff, coverage);
+        levels.push_back(std::move(level));
+    }
+    return levels;
+}
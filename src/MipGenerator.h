@@ -0,0 +1,30 @@
+#ifndef GRAPHICS_PROGRAMMING_MIP_GENERATOR_H
+#define GRAPHICS_PROGRAMMING_MIP_GENERATOR_H
+
+#include <vector>
+
+// CPU mip chains for baked textures, down to 1x1.
+// Every 2:1 step is a separable Kaiser windowed sinc over 8 taps per axis, computed from the level above
+// with one output row per ThreadPool task, vertical pass first so no source row is filtered twice.
+class MipGenerator
+{
+public:
+    enum class Content {
+        Color,      // sRGB colour filtered in linear light, alpha filtered as is
+        NormalMap   // tangent space vectors in RGB, renormalized after filtering
+    };
+
+    struct Level {
+        int width;
+        int height;
+        std::vector<unsigned char> rgba;
+    };
+
+    // alphaCutoff above 0 rescales the alpha of every level so the same share of texels passes
+    // an alpha test against that reference as on level 0, which keeps cut out foliage from thinning out
+    static std::vector<Level> generate(const unsigned char* rgba, int width, int height, Content content,
+                                       float alphaCutoff = 0.0f);
+
+    static Level downsample(const Level& source, Content content);
+};
+#endif //GRAPHICS_PROGRAMMING_MIP_GENERATOR_H
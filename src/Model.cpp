@@ -1,21 +1,107 @@
 #include "Model.h"
+#include "ModelCache.h"
+#include "ThreadPool.h"
+#include "UploadQueue.h"
+#include "TextureCache.h"
+#include "MeshOptimizer.h"
+#include "GeometryArena.h"
+#include "StartupProfiler.h"
+
+#include <algorithm>
+#include <cstring>
+#include <cstddef>
+#include <limits>
+#include <chrono>
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+
+#include "glm/gtc/packing.hpp"
 
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 
-Model::Mesh Model::processMesh(const aiMesh *mesh, const aiScene *scene) {
-    GLuint vao, vbo, ebo;
-    // create buffers/arrays
-    glGenVertexArrays(1, &vao);
-    glGenBuffers(1, &vbo);
-    glGenBuffers(1, &ebo);
+namespace {
+    const unsigned int importFlags = aiProcess_Triangulate |
+                                     aiProcess_JoinIdenticalVertices |
+                                     aiProcess_GenNormals |
+                                     aiProcess_FlipUVs |
+                                     aiProcess_CalcTangentSpace;
+//                                   aiProcess_GenUVCoords
+//                                   aiProcess_SortByPType
+
+    int16_t packSnorm16(float value) {
+        return (int16_t) std::round(glm::clamp(value, -1.0f, 1.0f) * 32767.0f);
+    }
+
+    // octahedral mapping of a unit vector onto the [-1, 1] square
+    void packOctahedral(const float *v, int16_t *packed) {
+        float sum = std::abs(v[0]) + std::abs(v[1]) + std::abs(v[2]);
+        if (sum == 0.0f) {
+            packed[0] = packed[1] = 0;
+            return;
+        }
+        float x = v[0] / sum, y = v[1] / sum;
+        if (v[2] < 0.0f) {
+            float fx = (1.0f - std::abs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+            float fy = (1.0f - std::abs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+            x = fx;
+            y = fy;
+        }
+        packed[0] = packSnorm16(x);
+        packed[1] = packSnorm16(y);
+    }
+}
+
+// finer levels first, each one must stay monotonic in error for selectLod
+const Model::LodTarget Model::lodTargets[] = {
+        {0.5f, 0.004f},
+        {0.25f, 0.01f},
+        {0.1f, 0.03f},
+};
+const unsigned int Model::lodTargetCount = sizeof(lodTargets) / sizeof(lodTargets[0]);
+
+// CPU half of a streamed load, produced on a worker.
+// meshViews point either into the mapped cache or into meshData.
+struct Model::SceneData {
+    uint64_t sourceHash = 0;
+    bool fromCache = false;
+    ModelCache cache;
+    std::vector<MeshData> meshData;
+    std::vector<ModelCache::MeshView> meshViews;
+    std::vector<MaterialData> materialData;
+    // only filled for VertexFormat::Compact
+    std::vector<CompactMeshData> compactData;
+    glm::vec3 positionScale = glm::vec3(1.0f);
+    glm::vec3 positionOffset = glm::vec3(0.0f);
+};
+
+struct Model::StreamingState {
+    Model *model = nullptr;
+    std::string cachePath;
+    std::future<std::shared_ptr<SceneData>> pendingScene;
+    std::shared_ptr<SceneData> scene;
+    std::vector<PendingImages> images;
+    size_t pendingUploads = 0;
+};
 
-    glBindVertexArray(vao);
+Model::MeshData Model::processMesh(const aiMesh *mesh, const aiMatrix4x4 &transform) {
+    StartupProfiler::Scope profile("Mesh pack");
+    MeshData meshData;
+    meshData.name = mesh->mName.C_Str();
+    meshData.materialID = mesh->mMaterialIndex;
+
+    // tangents follow the surface like positions, normals need the inverse transpose
+    aiMatrix3x3 tangentTransform(transform);
+    aiMatrix3x3 normalTransform = aiMatrix3x3(transform).Inverse().Transpose();
+    bool identity = transform.IsIdentity();
+    // a mirroring transform turns the triangles inside out
+    bool mirrored = tangentTransform.Determinant() < 0.0f;
 
     // load data into vertex buffers
-    unsigned int vsize = 11;
-    int vertices_size = sizeof(float) * vsize * mesh->mNumVertices;
-    auto *vertices = (float*)malloc(vertices_size);
+    const unsigned int vsize = MeshData::vertexSize;
+    meshData.vertices.resize(vsize * mesh->mNumVertices);
+    float *vertices = meshData.vertices.data();
 
     for (unsigned int i = 0; i < mesh->mNumVertices; i++)
     {
@@ -23,6 +109,11 @@ Model::Mesh Model::processMesh(const aiMesh *mesh, const aiScene *scene) {
         aiVector3D norm = mesh->mNormals[i];
         aiVector3D tang = mesh->HasTangentsAndBitangents()? mesh->mTangents[i] : aiVector3D(0.0, 0.0, 0.0);
         aiVector3D uv = mesh->HasTextureCoords(0) ? mesh->mTextureCoords[0][i] : aiVector3D(0.0);
+        if (!identity) {
+            vert = transform * vert;
+            norm = (normalTransform * norm).NormalizeSafe();
+            tang = (tangentTransform * tang).NormalizeSafe();
+        }
 
         //vertices
         vertices[i * vsize] = vert.x;
@@ -44,13 +135,7 @@ Model::Mesh Model::processMesh(const aiMesh *mesh, const aiScene *scene) {
         vertices[i * vsize + 10] = tang.z;
     }
 
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
-    glBufferData(GL_ARRAY_BUFFER, vertices_size, vertices, GL_STATIC_DRAW);
-    free(vertices);
-
-    int indices_size = sizeof(unsigned int) * 3 * mesh->mNumFaces;
-    auto *indices = (unsigned int*)malloc(indices_size);
-    int face_count = 0;
+    meshData.indices.reserve(3 * mesh->mNumFaces);
     for (unsigned int i = 0; i < mesh->mNumFaces; i++)
     {
         aiFace face = mesh->mFaces[i];
@@ -60,53 +145,472 @@ Model::Mesh Model::processMesh(const aiMesh *mesh, const aiScene *scene) {
         assert(face.mNumIndices == 3);
 
         // retrieve all indices of the face and store them in the indices vector
-        for (unsigned int j = 0; j < face.mNumIndices; j++)
-            indices[face_count * 3 + j] = face.mIndices[j];
-        face_count++;
+        meshData.indices.push_back(face.mIndices[0]);
+        meshData.indices.push_back(face.mIndices[mirrored ? 2 : 1]);
+        meshData.indices.push_back(face.mIndices[mirrored ? 1 : 2]);
+    }
+    return meshData;
+}
+
+std::vector<Model::MeshData> Model::batchByMaterial(std::vector<MeshData> &meshes) {
+    StartupProfiler::Scope profile("Mesh pack");
+    const unsigned int vsize = MeshData::vertexSize;
+    std::vector<MeshData> batches;
+    std::unordered_map<unsigned int, size_t> batchOf;
+    std::vector<unsigned int> sourceCount;
+    for (auto &mesh: meshes) {
+        auto found = batchOf.find(mesh.materialID);
+        if (found == batchOf.end()) {
+            found = batchOf.emplace(mesh.materialID, batches.size()).first;
+            batches.emplace_back();
+            batches.back().materialID = mesh.materialID;
+            sourceCount.push_back(0);
+        }
+        MeshData &batch = batches[found->second];
+        sourceCount[found->second]++;
+        if (batch.name.empty())
+            batch.name = mesh.name;
+
+        auto baseVertex = (unsigned int) (batch.vertices.size() / vsize);
+        batch.vertices.insert(batch.vertices.end(), mesh.vertices.begin(), mesh.vertices.end());
+        batch.indices.reserve(batch.indices.size() + mesh.indices.size());
+        for (unsigned int index: mesh.indices)
+            batch.indices.push_back(baseVertex + index);
+        // the source is consumed, only one copy of the scene is alive at a time
+        std::vector<float>().swap(mesh.vertices);
+        std::vector<unsigned int>().swap(mesh.indices);
+    }
+    for (size_t i = 0; i < batches.size(); i++) {
+        if (sourceCount[i] > 1)
+            batches[i].name += " +" + std::to_string(sourceCount[i] - 1);
     }
+    std::cout << "Static batching: " << meshes.size() << " meshes -> " << batches.size() << " draws" << std::endl;
+    meshes.clear();
+    return batches;
+}
+
+void Model::finishMesh(MeshData &meshData) {
+    StartupProfiler::Scope profile("Mesh optimize");
+    optimizeMesh(meshData);
+    computeBounds(meshData);
+    buildLods(meshData);
+}
+
+void Model::computeBounds(MeshData &meshData) {
+    const unsigned int vsize = MeshData::vertexSize;
+    size_t vertexCount = meshData.vertices.size() / vsize;
+    if (vertexCount == 0)
+        return;
+    const float *vertices = meshData.vertices.data();
+    glm::vec3 lower, upper, center;
+    float radiusSquared = 0.0f;
+#if defined(__SSE2__) || defined(_M_X64)
+    // one unaligned load per vertex, the fourth lane is normal.x and never leaves the registers
+    __m128 minimum = _mm_loadu_ps(vertices), maximum = minimum;
+    for (size_t i = 1; i < vertexCount; i++) {
+        __m128 position = _mm_loadu_ps(vertices + i * vsize);
+        minimum = _mm_min_ps(minimum, position);
+        maximum = _mm_max_ps(maximum, position);
+    }
+    alignas(16) float lanes[4];
+    _mm_store_ps(lanes, minimum);
+    lower = glm::make_vec3(lanes);
+    _mm_store_ps(lanes, maximum);
+    upper = glm::make_vec3(lanes);
+    center = (lower + upper) * 0.5f;
+
+    __m128 centerLanes = _mm_setr_ps(center.x, center.y, center.z, 0.0f);
+    __m128 largest = _mm_setzero_ps();
+    for (size_t i = 0; i < vertexCount; i++) {
+        __m128 offset = _mm_sub_ps(_mm_loadu_ps(vertices + i * vsize), centerLanes);
+        __m128 squared = _mm_mul_ps(offset, offset);
+        // x + y + z in lane 0
+        __m128 sum = _mm_add_ss(_mm_add_ss(squared, _mm_shuffle_ps(squared, squared, _MM_SHUFFLE(1, 1, 1, 1))),
+                                _mm_shuffle_ps(squared, squared, _MM_SHUFFLE(2, 2, 2, 2)));
+        largest = _mm_max_ss(largest, sum);
+    }
+    radiusSquared = _mm_cvtss_f32(largest);
+#else
+    lower = upper = glm::make_vec3(vertices);
+    for (size_t i = 1; i < vertexCount; i++) {
+        lower = glm::min(lower, glm::make_vec3(vertices + i * vsize));
+        upper = glm::max(upper, glm::make_vec3(vertices + i * vsize));
+    }
+    center = (lower + upper) * 0.5f;
+    for (size_t i = 0; i < vertexCount; i++) {
+        glm::vec3 offset = glm::make_vec3(vertices + i * vsize) - center;
+        radiusSquared = std::max(radiusSquared, glm::dot(offset, offset));
+    }
+#endif
+    meshData.boundsMin = lower;
+    meshData.boundsMax = upper;
+    meshData.boundingSphere = glm::vec4(center, std::sqrt(radiusSquared));
+}
+
+void Model::updateBounds() {
+    if (meshes.empty())
+        return;
+    boundsMin = meshes[0].boundsMin;
+    boundsMax = meshes[0].boundsMax;
+    for (auto &mesh: meshes) {
+        boundsMin = glm::min(boundsMin, mesh.boundsMin);
+        boundsMax = glm::max(boundsMax, mesh.boundsMax);
+    }
+    // centered on the box like the mesh spheres, wide enough for each of them
+    glm::vec3 center = (boundsMin + boundsMax) * 0.5f;
+    float radius = 0.0f;
+    for (auto &mesh: meshes)
+        radius = std::max(radius, glm::length(glm::vec3(mesh.boundingSphere) - center) + mesh.boundingSphere.w);
+    boundingSphere = glm::vec4(center, radius);
+}
+
+void Model::buildLods(MeshData &meshData) {
+    const unsigned int vsize = MeshData::vertexSize;
+    size_t vertexCount = meshData.vertices.size() / vsize;
+    meshData.lods.assign(1, Lod{0, (unsigned int) meshData.indices.size(), 0.0f, 0, 0});
+    meshData.meshlets.clear();
+    buildMeshlets(meshData);
+    const std::vector<unsigned int> full = meshData.indices;
+
+    std::ostringstream report;
+    report << "Mesh LODs: " << meshData.name << " " << full.size() / 3 << " (" << meshData.lods[0].meshletCount
+           << " clusters)";
+    for (unsigned int level = 0; level < lodTargetCount; level++) {
+        // every level simplifies the full mesh, so errors do not compound along the chain
+        size_t targetCount = (size_t) ((float) (full.size() / 3) * lodTargets[level].triangleRatio) * 3;
+        float error = 0.0f;
+        std::vector<unsigned int> indices = MeshOptimizer::simplify(full, meshData.vertices, vsize, targetCount,
+                                                                    lodTargets[level].maxError, 0.01f, &error);
+        // a level that saves less than a fifth of the previous one only costs memory
+        if (indices.empty() || indices.size() * 5 > (size_t) meshData.lods.back().indexCount * 4)
+            break;
+        MeshOptimizer::optimizeVertexCache(indices, vertexCount);
+        meshData.lods.push_back(Lod{(unsigned int) meshData.indices.size(), (unsigned int) indices.size(),
+                                    std::max(error, meshData.lods.back().error), 0, 0});
+        meshData.indices.insert(meshData.indices.end(), indices.begin(), indices.end());
+        buildMeshlets(meshData);
+        report << " -> " << indices.size() / 3 << " (" << meshData.lods.back().meshletCount << ")";
+    }
+    report << " triangles\n";
+    std::cout << report.str() << std::flush;
+}
+
+void Model::buildMeshlets(MeshData &meshData) {
+    Lod &lod = meshData.lods.back();
+    auto first = meshData.indices.begin() + lod.indexOffset;
+    std::vector<unsigned int> indices(first, first + lod.indexCount);
+    std::vector<Meshlet> meshlets = MeshOptimizer::buildMeshlets(indices, meshData.vertices, MeshData::vertexSize);
+    std::copy(indices.begin(), indices.end(), first);
+
+    lod.meshletOffset = (unsigned int) meshData.meshlets.size();
+    lod.meshletCount = (unsigned int) meshlets.size();
+    for (auto &meshlet: meshlets) {
+        meshlet.indexOffset += lod.indexOffset;
+        meshData.meshlets.push_back(meshlet);
+    }
+}
+
+unsigned int Model::selectLod(const Mesh &mesh, const glm::mat4 &modelMatrix, const glm::vec3 &viewPosition,
+                              float projectionScale, float maxPixelError) {
+    if (mesh.lods.size() < 2)
+        return 0;
+    float scale = std::max(std::max(glm::length(glm::vec3(modelMatrix[0])), glm::length(glm::vec3(modelMatrix[1]))),
+                           glm::length(glm::vec3(modelMatrix[2])));
+    glm::vec3 center = glm::vec3(modelMatrix * glm::vec4(glm::vec3(mesh.boundingSphere), 1.0f));
+    // distance to the nearest point of the bounding sphere, inside it only the full mesh will do
+    float distance = glm::length(viewPosition - center) - mesh.boundingSphere.w * scale;
+    if (distance <= 0.0f)
+        return 0;
+    for (unsigned int lod = (unsigned int) mesh.lods.size() - 1; lod > 0; lod--) {
+        if (mesh.lods[lod].error * scale / distance * projectionScale <= maxPixelError)
+            return lod;
+    }
+    return 0;
+}
+
+void Model::optimizeMesh(MeshData &meshData) {
+    const unsigned int vsize = MeshData::vertexSize;
+    size_t vertexCount = meshData.vertices.size() / vsize;
+    MeshOptimizer::CacheStats before = MeshOptimizer::analyzeVertexCache(meshData.indices, vertexCount);
+
+    // Assimp keeps the face order of the file, which is rarely friendly to the post-transform cache
+    MeshOptimizer::optimizeVertexCache(meshData.indices, vertexCount);
+    MeshOptimizer::optimizeOverdraw(meshData.indices, meshData.vertices, vsize);
+    vertexCount = MeshOptimizer::optimizeVertexFetch(meshData.vertices, meshData.indices, vsize);
 
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, (GLuint)(face_count * 3 * sizeof(unsigned int)), indices, GL_STATIC_DRAW);
-    free(indices);
+    MeshOptimizer::CacheStats after = MeshOptimizer::analyzeVertexCache(meshData.indices, vertexCount);
+    // meshes are optimized on several workers, one write keeps the lines intact
+    std::ostringstream report;
+    report << "Mesh optimized: " << meshData.name << " ACMR " << before.acmr << " -> " << after.acmr
+           << " ATVR " << before.atvr << " -> " << after.atvr << "\n";
+    std::cout << report.str() << std::flush;
+}
 
+void Model::setVertexAttributes(VertexFormat format) {
     // set the vertex attribute pointers
-    // vertex Positions
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(float) * vsize, (GLvoid*)nullptr);
-    // vertex normals
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(float) * vsize, (GLvoid*)(sizeof(float) * 3));
-    // vertex texture coords
-    glEnableVertexAttribArray(2);
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(float) * vsize, (GLvoid*)(sizeof(float) * 6));
-    // vertex tangents
-    glEnableVertexAttribArray(3);
-    glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(float) * vsize, (GLvoid*)(sizeof(float) * 8));
-    glBindVertexArray(0);
-    std::cout << "Mesh loaded: " << mesh->mName.C_Str() << std::endl;
-    return Mesh{ vao, 3 * mesh->mNumFaces, mesh->mMaterialIndex };
-}
-
-void Model::processNode(aiNode *node, const aiScene *scene) {
+    if (format == VertexFormat::Compact) {
+        const GLsizei stride = sizeof(CompactVertex);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_TRUE, stride, (GLvoid*)offsetof(CompactVertex, position));
+        // normal and tangent arrive as the two octahedral components, z defaults to 0
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 2, GL_SHORT, GL_TRUE, stride, (GLvoid*)offsetof(CompactVertex, normal));
+        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, stride, (GLvoid*)offsetof(CompactVertex, uv));
+        glEnableVertexAttribArray(3);
+        glVertexAttribPointer(3, 2, GL_SHORT, GL_TRUE, stride, (GLvoid*)offsetof(CompactVertex, tangent));
+    } else {
+        const unsigned int vsize = MeshData::vertexSize;
+        // vertex Positions
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(float) * vsize, (GLvoid*)nullptr);
+        // vertex normals
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(float) * vsize, (GLvoid*)(sizeof(float) * 3));
+        // vertex texture coords
+        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(float) * vsize, (GLvoid*)(sizeof(float) * 6));
+        // vertex tangents
+        glEnableVertexAttribArray(3);
+        glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(float) * vsize, (GLvoid*)(sizeof(float) * 8));
+    }
+}
+
+size_t Model::vertexStride(VertexFormat format) {
+    return format == VertexFormat::Compact ? sizeof(CompactVertex) : sizeof(float) * MeshData::vertexSize;
+}
+
+GeometryArena &Model::geometryArena(VertexFormat format) {
+    // one arena per layout, created on first use from the context thread
+    static GeometryArena floatArena((GLsizei) vertexStride(VertexFormat::Float),
+                                    []() { setVertexAttributes(VertexFormat::Float); });
+    static GeometryArena compactArena((GLsizei) vertexStride(VertexFormat::Compact),
+                                      []() { setVertexAttributes(VertexFormat::Compact); });
+    return format == VertexFormat::Compact ? compactArena : floatArena;
+}
+
+Model::Mesh Model::uploadMesh(const MeshView &view, const void *vertices, const void *indices, GLenum indexType) {
+    GeometryArena &arena = geometryArena(vertexFormat);
+    size_t indexSize = indexType == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(unsigned int);
+    GeometryArena::Allocation allocation = arena.allocate(view.vertexCount, indexSize * view.indexCount);
+    allocations.push_back(allocation);
+
+    // the copy target leaves the element binding of whatever VAO is bound alone
+    if (vertices) {
+        glBindBuffer(GL_COPY_WRITE_BUFFER, arena.vertexBuffer(allocation.block));
+        glBufferSubData(GL_COPY_WRITE_BUFFER, (GLintptr) arena.vertexOffset(allocation),
+                        (GLsizeiptr) (vertexStride(vertexFormat) * view.vertexCount), vertices);
+    }
+    if (indices) {
+        glBindBuffer(GL_COPY_WRITE_BUFFER, arena.indexBuffer(allocation.block));
+        glBufferSubData(GL_COPY_WRITE_BUFFER, (GLintptr) allocation.indexOffset,
+                        (GLsizeiptr) allocation.indexBytes, indices);
+    }
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    Mesh mesh{};
+    mesh.vao = arena.vertexArray(allocation.block);
+    mesh.indicesCount = view.lods[0].indexCount;
+    mesh.materialID = view.materialID;
+    mesh.indexType = indexType;
+    mesh.lods.assign(view.lods, view.lods + view.lodCount);
+    mesh.boundsMin = view.boundsMin;
+    mesh.boundsMax = view.boundsMax;
+    mesh.boundingSphere = view.boundingSphere;
+    mesh.meshletOffset = (unsigned int) meshlets.size();
+    meshlets.insert(meshlets.end(), view.meshlets, view.meshlets + view.meshletCount);
+    mesh.baseVertex = allocation.baseVertex;
+    mesh.indexOffset = allocation.indexOffset;
+    return mesh;
+}
+
+void Model::uploadMeshes(const std::vector<MeshView> &views) {
+    StartupProfiler::Scope profile("GL upload");
+    if (vertexFormat == VertexFormat::Float) {
+        for (auto &view: views) {
+            meshes.push_back(uploadMesh(view, view.vertices, view.indices, GL_UNSIGNED_INT));
+            std::cout << "Mesh loaded: " << view.name << std::endl;
+        }
+        uploadMeshlets();
+        updateBounds();
+        return;
+    }
+
+    // every mesh shares the model's range, so one pair of uniforms dequantizes the whole model
+    quantizationRange(views, positionScale, positionOffset);
+    ThreadPool &pool = ThreadPool::shared();
+    std::vector<std::future<CompactMeshData>> compressed;
+    glm::vec3 scale = positionScale, offset = positionOffset;
+    for (auto &view: views)
+        compressed.push_back(pool.submit([&view, scale, offset]() {
+            StartupProfiler::Scope profile("Vertex compress");
+            return compressMesh(view, scale, offset);
+        }));
+    for (size_t i = 0; i < views.size(); i++) {
+        CompactMeshData mesh = compressed[i].get();
+        meshes.push_back(uploadMesh(views[i], mesh.vertices.data(), mesh.indices.data(), mesh.indexType));
+        std::cout << "Mesh loaded: " << views[i].name << std::endl;
+    }
+    uploadMeshlets();
+    updateBounds();
+}
+
+void Model::uploadMeshlets() {
+    // a few KB per model, small enough to skip the upload queue even when streaming
+    static_assert(sizeof(Meshlet) == 4 * sizeof(glm::vec4), "Meshlet must match the std430 layout");
+    glGenBuffers(1, &meshletBuffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, meshletBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, (GLsizeiptr) (meshlets.size() * sizeof(Meshlet)), meshlets.data(),
+                 GL_STATIC_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+Model::ClusterView Model::ClusterView::frustum(const glm::mat4 &viewProjection, const glm::vec3 &eye,
+                                               bool backfaceCulling) {
+    // Gribb and Hartmann, each plane is the last row of the matrix plus or minus one of the others
+    ClusterView view;
+    glm::mat4 rows = glm::transpose(viewProjection);
+    for (int i = 0; i < 3; i++) {
+        view.planes[i * 2] = rows[3] + rows[i];
+        view.planes[i * 2 + 1] = rows[3] - rows[i];
+    }
+    for (auto &plane: view.planes)
+        plane /= glm::length(glm::vec3(plane));
+    view.planeCount = 6;
+    view.position = eye;
+    view.backfaceCulling = backfaceCulling;
+    return view;
+}
+
+Model::ClusterView Model::ClusterView::sphere(const glm::vec3 &center, float radius) {
+    ClusterView view;
+    view.position = center;
+    view.range = radius;
+    // casters facing away from the light still shadow it when faces are not culled
+    view.backfaceCulling = false;
+    return view;
+}
+
+void Model::cullClusters(const Mesh &mesh, unsigned int lod, const glm::mat4 &modelMatrix, const ClusterView &view,
+                         ClusterDraws &draws) const {
+    draws.counts.clear();
+    draws.offsets.clear();
+    draws.baseVertices.clear();
+    draws.visible = draws.total = 0;
+    if (mesh.indicesCount == 0 || mesh.lods.empty())
+        return;
+
+    const Lod &level = mesh.lods[std::min<size_t>(lod, mesh.lods.size() - 1)];
+    size_t indexSize = mesh.indexType == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(unsigned int);
+    float scale = std::max(std::max(glm::length(glm::vec3(modelMatrix[0])), glm::length(glm::vec3(modelMatrix[1]))),
+                           glm::length(glm::vec3(modelMatrix[2])));
+    glm::mat3 rotation = glm::mat3(modelMatrix) / scale;
+    size_t rangeEnd = 0;
+    draws.total = level.meshletCount;
+    for (unsigned int i = 0; i < level.meshletCount; i++) {
+        const Meshlet &meshlet = meshlets[mesh.meshletOffset + level.meshletOffset + i];
+        glm::vec3 center = glm::vec3(modelMatrix * glm::vec4(glm::make_vec3(meshlet.center), 1.0f));
+        float radius = meshlet.radius * scale;
+
+        bool visible = true;
+        for (unsigned int p = 0; p < view.planeCount && visible; p++)
+            visible = glm::dot(glm::vec3(view.planes[p]), center) + view.planes[p].w > -radius;
+        glm::vec3 toCenter = center - view.position;
+        float distance = glm::length(toCenter);
+        if (visible && view.range > 0.0f)
+            visible = distance - radius < view.range;
+        if (visible && view.backfaceCulling && meshlet.coneCutoff < 1.0f) {
+            glm::vec3 axis = rotation * glm::make_vec3(meshlet.coneAxis);
+            visible = glm::dot(toCenter, axis) < meshlet.coneCutoff * distance + radius;
+        }
+        if (!visible)
+            continue;
+
+        draws.visible++;
+        GLsizei count = (GLsizei) (meshlet.triangleCount * 3);
+        if (!draws.counts.empty() && rangeEnd == meshlet.indexOffset) {
+            draws.counts.back() += count;
+        } else {
+            draws.counts.push_back(count);
+            draws.offsets.push_back((GLvoid *) (mesh.indexOffset + meshlet.indexOffset * indexSize));
+            draws.baseVertices.push_back(mesh.baseVertex);
+        }
+        rangeEnd = meshlet.indexOffset + meshlet.triangleCount * 3;
+    }
+}
+
+void Model::quantizationRange(const std::vector<MeshView> &views, glm::vec3 &scale, glm::vec3 &offset) {
+    glm::vec3 lower(std::numeric_limits<float>::max());
+    glm::vec3 upper(-std::numeric_limits<float>::max());
+    for (auto &view: views) {
+        for (unsigned int i = 0; i < view.vertexCount; i++) {
+            glm::vec3 position = glm::make_vec3(view.vertices + i * MeshData::vertexSize);
+            lower = glm::min(lower, position);
+            upper = glm::max(upper, position);
+        }
+    }
+    if (lower.x > upper.x) {
+        scale = glm::vec3(1.0f);
+        offset = glm::vec3(0.0f);
+        return;
+    }
+    offset = lower;
+    // a flat axis still needs a non zero scale
+    scale = glm::max(upper - lower, glm::vec3(1e-6f));
+}
+
+Model::CompactMeshData Model::compressMesh(const MeshView &view, glm::vec3 scale, glm::vec3 offset) {
+    CompactMeshData mesh;
+    mesh.vertices.resize(view.vertexCount);
+    for (unsigned int i = 0; i < view.vertexCount; i++) {
+        const float *vertex = view.vertices + i * MeshData::vertexSize;
+        CompactVertex &packed = mesh.vertices[i];
+        for (int k = 0; k < 3; k++) {
+            float normalized = glm::clamp((vertex[k] - offset[k]) / scale[k], 0.0f, 1.0f);
+            packed.position[k] = (uint16_t) std::round(normalized * 65535.0f);
+        }
+        packed.position[3] = 0;
+        packOctahedral(vertex + 3, packed.normal);
+        packed.uv[0] = glm::packHalf1x16(vertex[6]);
+        packed.uv[1] = glm::packHalf1x16(vertex[7]);
+        packOctahedral(vertex + 8, packed.tangent);
+    }
+
+    mesh.indexCount = view.indexCount;
+    if (view.vertexCount < 65536) {
+        mesh.indexType = GL_UNSIGNED_SHORT;
+        mesh.indices.resize(sizeof(uint16_t) * view.indexCount);
+        auto *indices = reinterpret_cast<uint16_t *>(mesh.indices.data());
+        for (unsigned int i = 0; i < view.indexCount; i++)
+            indices[i] = (uint16_t) view.indices[i];
+    } else {
+        mesh.indexType = GL_UNSIGNED_INT;
+        mesh.indices.resize(sizeof(unsigned int) * view.indexCount);
+        memcpy(mesh.indices.data(), view.indices, mesh.indices.size());
+    }
+    return mesh;
+}
+
+void Model::processNode(const aiNode *node, const aiScene *scene, const aiMatrix4x4 &parentTransform,
+                        std::vector<SceneMesh> &sceneMeshes) {
+    aiMatrix4x4 transform = parentTransform * node->mTransformation;
     // process all the node's meshes (if any)
     for (unsigned int i = 0; i < node->mNumMeshes; i++)
     {
-        aiMesh *mesh = scene->mMeshes[node->mMeshes[i]];
-
-        meshes.push_back(processMesh(mesh, scene));
+        sceneMeshes.push_back(SceneMesh{scene->mMeshes[node->mMeshes[i]], transform});
     }
     // then do the same for each of its children
     for (unsigned int i = 0; i < node->mNumChildren; i++)
     {
-        processNode(node->mChildren[i], scene);
+        processNode(node->mChildren[i], scene, transform, sceneMeshes);
     }
 }
 
-void Model::processMaterial(const aiScene *scene) {
+void Model::processMaterial(const aiScene *scene, std::vector<MaterialData> &materialData) {
     std::cout << "Material count: " << scene->mNumMaterials << std::endl;
     for (int i = 0; i < scene->mNumMaterials; i++)
     {
-        Material material{};
+        MaterialData material{};
         aiString name;
         scene->mMaterials[i]->Get(AI_MATKEY_NAME, name);
         std::cout << "Material " << i << " " << name.C_Str() << std::endl;
@@ -114,14 +618,12 @@ void Model::processMaterial(const aiScene *scene) {
         if (scene->mMaterials[i]->GetTextureCount(aiTextureType_DIFFUSE) > 0) {
             aiString str;
             scene->mMaterials[i]->GetTexture(aiTextureType_DIFFUSE, 0, &str);
-            material.textureID = loadTexture(str.C_Str());
-            material.hasTexture = true;
+            material.texturePath = str.C_Str();
         }
         if (scene->mMaterials[i]->GetTextureCount(aiTextureType_HEIGHT) > 0) {
             aiString str;
             scene->mMaterials[i]->GetTexture(aiTextureType_HEIGHT, 0, &str);
-            material.NormalMapID = loadNormalMap(str.C_Str());
-            material.hasNormalMap = true;
+            material.normalMapPath = str.C_Str();
         }
 
         aiColor3D color(0.f, 0.f, 0.f);
@@ -138,90 +640,500 @@ void Model::processMaterial(const aiScene *scene) {
         std::cout << "Shininess: " << color.r << std::endl;
         material.shininess = color.r;
 
+        materialData.push_back(material);
+    }
+}
+
+std::vector<Model::PendingImages> Model::acquireMaterials(const std::vector<MaterialData> &materialData) {
+    TextureCache &textureCache = TextureCache::shared();
+    ThreadPool &pool = ThreadPool::shared();
+    std::vector<PendingImages> images(materialData.size());
+    for (size_t i = 0; i < materialData.size(); i++) {
+        Material material{};
+        bool isNew;
+        // only the first reference to an image decodes it, every other material shares the texture
+        if (!materialData[i].texturePath.empty()) {
+            std::string path = directory + '/' + materialData[i].texturePath;
+            material.texture = textureCache.acquire(path, TextureCache::Format::Diffuse, isNew);
+            material.textureID = material.texture.id();
+            material.hasTexture = true;
+            if (isNew)
+                images[i].texture = pool.submit([path]() { return loadImage(path, TextureBake::Usage::Diffuse); });
+        }
+        if (!materialData[i].normalMapPath.empty()) {
+            std::string path = directory + '/' + materialData[i].normalMapPath;
+            material.normalMap = textureCache.acquire(path, TextureCache::Format::NormalMap, isNew);
+            material.NormalMapID = material.normalMap.id();
+            material.hasNormalMap = true;
+            if (isNew)
+                images[i].normalMap = pool.submit([path]() {
+                    return loadImage(path, TextureBake::Usage::NormalMap);
+                });
+        }
+        material.ambientColor = materialData[i].ambientColor;
+        material.diffuseColor = materialData[i].diffuseColor;
+        material.specularColor = materialData[i].specularColor;
+        material.shininess = materialData[i].shininess;
         materials[i] = material;
     }
+    return images;
 }
 
-GLuint Model::loadTexture(const std::string &pFile) {
-    GLuint textureID;
-    glGenTextures(1, &textureID);
+void Model::finishMaterials(const std::vector<MaterialData> &materialData, std::vector<PendingImages> &images) {
+    for (size_t i = 0; i < materialData.size(); i++) {
+        for (int normalMap = 0; normalMap < 2; normalMap++) {
+            std::future<std::shared_ptr<TextureBake>> &pending = normalMap ? images[i].normalMap : images[i].texture;
+            if (!pending.valid())
+                continue;
+            std::shared_ptr<TextureBake> bake = pending.get();
+            const std::string &path = normalMap ? materialData[i].normalMapPath : materialData[i].texturePath;
+            if (!bake)
+                std::cout << "Texture failed to load at path: " << path << std::endl;
+            else if (normalMap)
+                uploadNormalMap(materials[i].NormalMapID, *bake, path);
+            else
+                uploadTexture(materials[i].textureID, *bake, path);
+        }
+    }
+}
 
-    int width, height, nrComponents;
-    unsigned char *data = stbi_load((directory + '/' + pFile).c_str(), &width, &height, &nrComponents, 4);
-    if (data)
-    {
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
+bool Model::loadFromCache(const std::string &cachePath, uint64_t sourceHash) {
+    ModelCache cache;
+    StartupProfiler::Scope profile("Model cache read");
+    if (!cache.open(cachePath, sourceHash))
+        return false;
+    profile.stop();
 
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_MIRRORED_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_MIRRORED_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    // images decode on the pool while the buffers are filled straight from the mapped file
+    std::vector<PendingImages> images = acquireMaterials(cache.materials);
+    uploadMeshes(cache.meshes);
+    finishMaterials(cache.materials, images);
+    std::cout << "Model loaded from cache: " << cachePath << std::endl;
+    return true;
+}
 
-        std::cout << "Texture loaded: " << pFile << std::endl;
-        stbi_image_free(data);
-    }
-    else
-    {
-        std::cout << "Texture failed to load at path: " << pFile << std::endl;
-        stbi_image_free(data);
+std::shared_ptr<TextureBake> Model::loadImage(const std::string &path, TextureBake::Usage usage) {
+    StartupProfiler::Scope profile("Image decode");
+    auto bake = std::make_shared<TextureBake>();
+    if (!bake->load(path, usage))
+        return nullptr;
+    return bake;
+}
+
+void Model::specifyLevels(const TextureBake &bake, bool withData) {
+    for (size_t level = 0; level < bake.levels.size(); level++) {
+        const TextureBake::Level &data = bake.levels[level];
+        glCompressedTexImage2D(GL_TEXTURE_2D, (GLint) level, bake.internalFormat, data.width, data.height, 0,
+                               (GLsizei) data.size, withData ? data.data : nullptr);
     }
-    return textureID;
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint) bake.levels.size() - 1);
 }
 
-GLuint Model::loadNormalMap(std::string const& pFile)
-{
-    GLuint textureID;
-    glGenTextures(1, &textureID);
+void Model::setSampler(bool normalMap) {
+    GLint wrap = normalMap ? GL_REPEAT : GL_MIRRORED_REPEAT;
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrap);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrap);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+}
 
-    int width, height, nrComponents;
-    unsigned char* data = stbi_load((directory + '/' + pFile).c_str(), &width, &height, &nrComponents, 4);
-    if (data)
-    {
-        glActiveTexture(GL_TEXTURE5);
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
+void Model::uploadTexture(GLuint textureID, const TextureBake &bake, const std::string &pFile) {
+    StartupProfiler::Scope profile("GL upload");
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, textureID);
+    specifyLevels(bake, true);
+    setSampler(false);
+    TextureCache::shared().setResidentBytes(textureID, bake.size());
 
-       /*glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-       glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);*/
+    std::cout << "Texture loaded: " << pFile << " (" << bake.size() / 1024 << " KB)" << std::endl;
+}
+
+void Model::uploadNormalMap(GLuint textureID, const TextureBake &bake, std::string const& pFile)
+{
+    StartupProfiler::Scope profile("GL upload");
+    glActiveTexture(GL_TEXTURE5);
+    glBindTexture(GL_TEXTURE_2D, textureID);
+    specifyLevels(bake, true);
+    setSampler(true);
+    TextureCache::shared().setResidentBytes(textureID, bake.size());
 
-        std::cout << "Texture loaded: " << pFile << std::endl;
-        stbi_image_free(data);
+    std::cout << "Texture loaded: " << pFile << " (" << bake.size() / 1024 << " KB)" << std::endl;
+}
+
+Model::Model(const std::string &pFile, bool stream, VertexFormat format) : vertexFormat(format) {
+    directory = pFile.substr(0, pFile.find_last_of('/'));
+    if (!stream) {
+        load(pFile);
+        return;
     }
-    else
-    {
-        std::cout << "Texture failed to load at path: " << pFile << std::endl;
-        stbi_image_free(data);
+
+    streaming = std::make_shared<StreamingState>();
+    streaming->model = this;
+    streaming->cachePath = pFile + ".meshcache";
+    std::string cachePath = streaming->cachePath;
+    streaming->pendingScene = ThreadPool::shared().submit([pFile, cachePath, format]() {
+        return importScene(pFile, cachePath, format);
+    });
+    streamingModels().push_back(this);
+}
+
+Model::~Model() {
+    if (streaming) {
+        // uploads still in flight check this before touching the model
+        streaming->model = nullptr;
+        glDeleteBuffers(1, &meshletBuffer);
+        std::vector<Model *> &models = streamingModels();
+        models.erase(std::remove(models.begin(), models.end(), this), models.end());
+        // queued copies may still land in the arena ranges, so they are never handed out again
+        return;
     }
-    return textureID;
+    glDeleteBuffers(1, &meshletBuffer);
+    GeometryArena &arena = geometryArena(vertexFormat);
+    for (auto &allocation: allocations)
+        arena.release(allocation);
 }
 
-Model::Model(const std::string &pFile) {
+void Model::load(const std::string &pFile) {
+    // warm start: skip Assimp entirely when the baked cache matches the source files
+    std::string cachePath = pFile + ".meshcache";
+    uint64_t sourceHash = ModelCache::hashSource(pFile);
+    if (loadFromCache(cachePath, sourceHash))
+        return;
+
+    ThreadPool &pool = ThreadPool::shared();
+    std::vector<MaterialData> materialData;
+    std::vector<PendingImages> images;
+    std::vector<MeshData> rawMeshes;
     Assimp::Importer importer;
-    const struct aiScene* scene = importer.ReadFile(pFile.c_str(),
-                                               aiProcess_Triangulate |
-                                               aiProcess_GenNormals |
-                                               aiProcess_FlipUVs |
-                                               aiProcess_CalcTangentSpace
-//                                               aiProcess_GenUVCoords
-//                                               aiProcess_SortByPType
-    );
+    std::vector<ObjReader::Mesh> objMeshes;
+    if (isObj(pFile) && importObj(pFile, materialData, objMeshes)) {
+        images = acquireMaterials(materialData);
+        for (auto &mesh: objMeshes)
+            rawMeshes.push_back(objMesh(mesh));
+    } else {
+        const struct aiScene* scene = readScene(importer, pFile);
+        if (!scene)
+            return;
+
+        // Now we can access the file's contents
+        // materials are cheap to read, so their images start decoding before any mesh is packed
+        processMaterial(scene, materialData);
+        images = acquireMaterials(materialData);
+
+        // interleaving and index extraction only read the scene, so every mesh is packed on the pool
+        std::vector<SceneMesh> sceneMeshes;
+        processNode(scene->mRootNode, scene, aiMatrix4x4(), sceneMeshes);
+        std::vector<std::future<MeshData>> packed;
+        for (const SceneMesh &sceneMesh: sceneMeshes)
+            packed.push_back(pool.submit([sceneMesh]() { return processMesh(sceneMesh.mesh, sceneMesh.transform); }));
+        for (auto &mesh: packed)
+            rawMeshes.push_back(mesh.get());
+    }
+
+    // optimization and LODs of every batch run on the pool, whichever reader produced the triangles
+    std::vector<std::future<MeshData>> finishedMeshes;
+    for (auto &batch: batchByMaterial(rawMeshes)) {
+        auto raw = std::make_shared<MeshData>(std::move(batch));
+        finishedMeshes.push_back(pool.submit([raw]() {
+            finishMesh(*raw);
+            return std::move(*raw);
+        }));
+    }
+
+    // only the GL calls stay on the context thread, uploads follow the order of first material use
+    std::vector<MeshData> meshData;
+    std::vector<MeshView> views;
+    for (auto &finished: finishedMeshes)
+        meshData.push_back(finished.get());
+    for (auto &mesh: meshData)
+        views.push_back(meshView(mesh));
+    uploadMeshes(views);
+    finishMaterials(materialData, images);
+
+    // baking is pure I/O, so a worker writes the cache while startup carries on
+    pool.submit([cachePath, sourceHash, meshData = std::move(meshData), materialData = std::move(materialData)]() {
+        StartupProfiler::Scope profile("Model cache write");
+        if (!ModelCache::write(cachePath, sourceHash, meshData, materialData))
+            std::cout << "Failed to write model cache: " << cachePath << std::endl;
+    });
+}
+
+std::shared_ptr<Model::SceneData> Model::importScene(const std::string &pFile, const std::string &cachePath,
+                                                     VertexFormat format) {
+    auto sceneData = std::make_shared<SceneData>();
+    sceneData->sourceHash = ModelCache::hashSource(pFile);
+    StartupProfiler::Scope cacheRead("Model cache read");
+    bool cached = sceneData->cache.open(cachePath, sceneData->sourceHash);
+    cacheRead.stop();
+    if (cached) {
+        sceneData->fromCache = true;
+        sceneData->meshViews = sceneData->cache.meshes;
+        sceneData->materialData = sceneData->cache.materials;
+    } else if (!importMeshes(pFile, *sceneData)) {
+        return nullptr;
+    }
+
+    if (format == VertexFormat::Compact) {
+        StartupProfiler::Scope profile("Vertex compress");
+        quantizationRange(sceneData->meshViews, sceneData->positionScale, sceneData->positionOffset);
+        for (auto &view: sceneData->meshViews)
+            sceneData->compactData.push_back(compressMesh(view, sceneData->positionScale, sceneData->positionOffset));
+    }
+    return sceneData;
+}
+
+bool Model::importMeshes(const std::string &pFile, SceneData &sceneData) {
+    std::vector<ObjReader::Mesh> objMeshes;
+    std::vector<MeshData> rawMeshes;
+    if (isObj(pFile) && importObj(pFile, sceneData.materialData, objMeshes)) {
+        for (auto &mesh: objMeshes)
+            rawMeshes.push_back(objMesh(mesh));
+    } else {
+        Assimp::Importer importer;
+        const struct aiScene* scene = readScene(importer, pFile);
+        if (!scene)
+            return false;
+
+        processMaterial(scene, sceneData.materialData);
+        std::vector<SceneMesh> sceneMeshes;
+        processNode(scene->mRootNode, scene, aiMatrix4x4(), sceneMeshes);
+        for (const SceneMesh &sceneMesh: sceneMeshes)
+            rawMeshes.push_back(processMesh(sceneMesh.mesh, sceneMesh.transform));
+    }
+
+    // already on a worker, the model as a whole overlaps with every other load
+    sceneData.meshData = batchByMaterial(rawMeshes);
+    for (auto &mesh: sceneData.meshData)
+        finishMesh(mesh);
+    for (auto &mesh: sceneData.meshData)
+        sceneData.meshViews.push_back(meshView(mesh));
+    return true;
+}
+
+const aiScene *Model::readScene(Assimp::Importer &importer, const std::string &pFile) {
+    // parsing and post-processing are timed apart, they scale with different things
+    StartupProfiler::Scope parse("Assimp parse");
+    const struct aiScene* scene = importer.ReadFile(pFile.c_str(), 0);
+    parse.stop();
+    if (scene) {
+        StartupProfiler::Scope postProcess("Assimp post-process");
+        scene = importer.ApplyPostProcessing(importFlags);
+    }
 
     // If the import failed, report it
     if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) {
         std::cout << "ERROR ASSIMP " << importer.GetErrorString() << std::endl;
+        return nullptr;
     }
+    return scene;
+}
 
-    directory = pFile.substr(0, pFile.find_last_of('/'));
+bool Model::isObj(const std::string &pFile) {
+    std::string extension = pFile.substr(pFile.find_last_of('.') + 1);
+    return extension == "obj" || extension == "OBJ";
+}
+
+bool Model::importObj(const std::string &pFile, std::vector<MaterialData> &materialData,
+                      std::vector<ObjReader::Mesh> &meshes) {
+    StartupProfiler::Scope profile("OBJ parse");
+    ObjReader reader;
+    if (!reader.read(pFile)) {
+        std::cout << "OBJ reader failed, falling back to Assimp: " << pFile << std::endl;
+        return false;
+    }
+    profile.stop();
+    std::cout << "OBJ read: " << pFile << " " << reader.triangleCount() << " triangles, " << reader.meshes.size()
+              << " meshes" << std::endl;
+
+    std::cout << "Material count: " << reader.materials.size() << std::endl;
+    materialData.clear();
+    for (auto &material: reader.materials) {
+        MaterialData data{};
+        data.texturePath = material.diffuseMap;
+        data.normalMapPath = material.bumpMap;
+        data.ambientColor = glm::make_vec3(material.ambient);
+        data.diffuseColor = glm::make_vec3(material.diffuse);
+        data.specularColor = glm::make_vec3(material.specular);
+        data.shininess = material.shininess;
+        materialData.push_back(data);
+    }
+    meshes = std::move(reader.meshes);
+    return true;
+}
+
+Model::MeshData Model::objMesh(ObjReader::Mesh &mesh) {
+    static_assert(ObjReader::vertexSize == MeshData::vertexSize, "ObjReader writes the MeshData vertex layout");
+    MeshData meshData;
+    meshData.name = mesh.name;
+    meshData.materialID = mesh.materialID;
+    meshData.vertices = std::move(mesh.vertices);
+    meshData.indices = std::move(mesh.indices);
+    return meshData;
+}
+
+Model::MeshView Model::meshView(const MeshData &mesh) {
+    return MeshView{mesh.name, mesh.materialID,
+                    (unsigned int) (mesh.vertices.size() / MeshData::vertexSize), (unsigned int) mesh.indices.size(),
+                    mesh.vertices.data(), mesh.indices.data(), mesh.lods.data(), (unsigned int) mesh.lods.size(),
+                    mesh.meshlets.data(), (unsigned int) mesh.meshlets.size(), mesh.boundsMin, mesh.boundsMax,
+                    mesh.boundingSphere};
+}
+
+std::vector<Model *> &Model::streamingModels() {
+    static std::vector<Model *> models;
+    return models;
+}
+
+void Model::beginStreaming() {
+    std::shared_ptr<StreamingState> state = streaming;
+    std::shared_ptr<SceneData> scene = state->scene;
 
-    // Now we can access the file's contents
-    //DoTheSceneProcessing(scene);
-    processNode(scene->mRootNode, scene);
+    state->images = acquireMaterials(scene->materialData);
 
-    processMaterial(scene);
+    positionScale = scene->positionScale;
+    positionOffset = scene->positionOffset;
+
+    UploadQueue &queue = UploadQueue::shared();
+    for (size_t i = 0; i < scene->meshViews.size(); i++) {
+        const ModelCache::MeshView &view = scene->meshViews[i];
+        const void *vertices = view.vertices;
+        const void *indices = view.indices;
+        GLenum indexType = GL_UNSIGNED_INT;
+        if (vertexFormat == VertexFormat::Compact) {
+            const CompactMeshData &compact = scene->compactData[i];
+            vertices = compact.vertices.data();
+            indices = compact.indices.data();
+            indexType = compact.indexType;
+        }
+
+        // arena space only, the mesh draws nothing until its indices have arrived
+        Mesh mesh = uploadMesh(view, nullptr, nullptr, indexType);
+        mesh.indicesCount = 0;
+        meshes.push_back(mesh);
+
+        // the queue is FIFO, so the index upload completing implies the vertices are there too
+        const GeometryArena::Allocation &allocation = allocations.back();
+        GeometryArena &arena = geometryArena(vertexFormat);
+        queue.uploadBuffer(arena.vertexBuffer(allocation.block), arena.vertexOffset(allocation), vertices,
+                           vertexStride(vertexFormat) * view.vertexCount, scene, nullptr);
+        state->pendingUploads++;
+        unsigned int indexCount = view.lods[0].indexCount;
+        std::string name = view.name;
+        queue.uploadBuffer(arena.indexBuffer(allocation.block), allocation.indexOffset, indices,
+                           allocation.indexBytes, scene,
+                           [state, i, indexCount, name]() {
+                               state->pendingUploads--;
+                               if (!state->model)
+                                   return;
+                               state->model->meshes[i].indicesCount = indexCount;
+                               std::cout << "Mesh loaded: " << name << std::endl;
+                           });
+    }
+    uploadMeshlets();
+    updateBounds();
+
+    if (!scene->fromCache) {
+        std::string cachePath = state->cachePath;
+        ThreadPool::shared().submit([scene, cachePath]() {
+            StartupProfiler::Scope profile("Model cache write");
+            if (!ModelCache::write(cachePath, scene->sourceHash, scene->meshData, scene->materialData))
+                std::cout << "Failed to write model cache: " << cachePath << std::endl;
+        });
+    }
+}
+
+void Model::streamImages() {
+    std::shared_ptr<StreamingState> state = streaming;
+    UploadQueue &queue = UploadQueue::shared();
+    for (size_t i = 0; i < state->images.size(); i++) {
+        for (int normalMap = 0; normalMap < 2; normalMap++) {
+            std::future<std::shared_ptr<TextureBake>> &pending = normalMap ? state->images[i].normalMap
+                                                                           : state->images[i].texture;
+            if (!pending.valid() || pending.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+                continue;
+
+            std::shared_ptr<TextureBake> bake = pending.get();
+            const std::string &path = normalMap ? state->scene->materialData[i].normalMapPath
+                                                : state->scene->materialData[i].texturePath;
+            if (!bake) {
+                // keep the placeholder
+                std::cout << "Texture failed to load at path: " << path << std::endl;
+                continue;
+            }
+
+            // levels land in a staging texture, the cached one keeps its placeholder until the copy
+            GLuint stagingTexture;
+            glGenTextures(1, &stagingTexture);
+            glBindTexture(GL_TEXTURE_2D, stagingTexture);
+            specifyLevels(*bake, false);
+            glBindTexture(GL_TEXTURE_2D, 0);
+
+            GLuint textureID = normalMap ? materials[i].NormalMapID : materials[i].textureID;
+            // the queue is FIFO, so the last level completing means the whole chain is there
+            for (size_t level = 0; level < bake->levels.size(); level++) {
+                const TextureBake::Level &data = bake->levels[level];
+                std::function<void()> onComplete;
+                if (level + 1 == bake->levels.size()) {
+                    state->pendingUploads++;
+                    onComplete = [state, normalMap, stagingTexture, textureID, bake, path]() {
+                        state->pendingUploads--;
+                        if (state->model) {
+                            // respecify and fill in the same frame, nothing ever samples partial data
+                            glBindTexture(GL_TEXTURE_2D, textureID);
+                            specifyLevels(*bake, false);
+                            for (size_t copy = 0; copy < bake->levels.size(); copy++) {
+                                glCopyImageSubData(stagingTexture, GL_TEXTURE_2D, (GLint) copy, 0, 0, 0,
+                                                   textureID, GL_TEXTURE_2D, (GLint) copy, 0, 0, 0,
+                                                   bake->levels[copy].width, bake->levels[copy].height, 1);
+                            }
+                            setSampler(normalMap);
+                            TextureCache::shared().setResidentBytes(textureID, bake->size());
+                            glBindTexture(GL_TEXTURE_2D, 0);
+                            std::cout << "Texture loaded: " << path << " (" << bake->size() / 1024 << " KB)"
+                                      << std::endl;
+                        }
+                        glDeleteTextures(1, &stagingTexture);
+                    };
+                }
+                queue.uploadCompressedTexture(stagingTexture, (int) level, bake->internalFormat, data.width,
+                                              data.height, data.data, data.size, bake, std::move(onComplete));
+            }
+        }
+    }
+}
+
+bool Model::updateStreamingState() {
+    StreamingState &state = *streaming;
+    if (!state.scene) {
+        if (state.pendingScene.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+            return false;
+        state.scene = state.pendingScene.get();
+        // a failed import leaves the model empty
+        if (!state.scene)
+            return true;
+        beginStreaming();
+    }
+
+    streamImages();
+    for (auto &images: state.images) {
+        if (images.texture.valid() || images.normalMap.valid())
+            return false;
+    }
+    return state.pendingUploads == 0;
+}
+
+void Model::updateStreaming(size_t byteBudget) {
+    // placeholders, buffer and texture uploads, whatever the frame's budget allows
+    StartupProfiler::Scope profile("GL upload");
+    std::vector<Model *> &models = streamingModels();
+    for (size_t i = 0; i < models.size();) {
+        if (models[i]->updateStreamingState()) {
+            models[i]->streaming.reset();
+            models.erase(models.begin() + i);
+        } else {
+            i++;
+        }
+    }
+    UploadQueue::shared().process(byteBudget);
 }
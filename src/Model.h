@@ -2,11 +2,15 @@
 #define GRAPHICS_PROGRAMMING_MODEL_H
 
 #include <string>
+#include <vector>
 #include <fstream>
 #include <sstream>
 #include <iostream>
 #include <unordered_map>
+#include <future>
+#include <memory>
 #include <cmath>
+#include <cstdint>
 
 #include "GL/glew.h"
 #include "glm/glm.hpp"
@@ -17,14 +21,46 @@
 #include "assimp/scene.h"
 #include "assimp/postprocess.h"
 
+#include "TextureCache.h"
+#include "TextureBake.h"
+#include "GeometryArena.h"
+#include "MeshOptimizer.h"
+#include "ObjReader.h"
+
 
 class Model {
 public:
+	enum class VertexFormat {
+		Float,   // 44 bytes, float position, normal, uv and tangent
+		Compact  // 20 bytes, see CompactVertex
+	};
+	// about 64 vertices and 124 triangles of one LOD, with object space bounds and normal cone
+	typedef MeshOptimizer::Meshlet Meshlet;
+	// one level of detail, a range of the mesh's index data drawn against the same vertices
+	struct Lod {
+		unsigned int indexOffset;   // in indices
+		unsigned int indexCount;
+		float error;                // largest simplification error, in object space units
+		// the level's clusters, which cover its index range in order
+		unsigned int meshletOffset;
+		unsigned int meshletCount;
+	};
 	struct Mesh {
 		GLuint vao;
 		unsigned int indicesCount;
 		unsigned int materialID;
         glm::vec3 color;
+		GLenum indexType = GL_UNSIGNED_INT;
+		// vao is the shared geometry arena block, draw with glDrawElementsBaseVertex
+		GLint baseVertex = 0;
+		size_t indexOffset = 0;
+		// lods[0] is the full mesh, indicesCount stays 0 while a streamed mesh is uploading
+		std::vector<Lod> lods;
+		// object space, the sphere is centered on the box
+		glm::vec3 boundsMin = glm::vec3(0.0f);
+		glm::vec3 boundsMax = glm::vec3(0.0f);
+		glm::vec4 boundingSphere = glm::vec4(0.0f);  // center and radius
+		unsigned int meshletOffset = 0;  // first cluster in Model::meshlets, Lod::meshletOffset is relative to it
 	};
 	struct Material {
 		bool hasTexture = false;
@@ -35,19 +71,193 @@ public:
         float shininess;
 		GLuint textureID;
 		GLuint NormalMapID;
+		// keep the shared textures alive while the material exists
+		TextureCache::Handle texture;
+		TextureCache::Handle normalMap;
+	};
+	// CPU side mesh, vertices are interleaved position, normal, uv, tangent
+	struct MeshData {
+		static const unsigned int vertexSize = 11;
+		std::string name;
+		unsigned int materialID = 0;
+		std::vector<float> vertices;
+		std::vector<unsigned int> indices;  // every LOD back to back, finest first
+		std::vector<Lod> lods;
+		std::vector<Meshlet> meshlets;      // every LOD's clusters, index offsets count from the mesh start
+		glm::vec3 boundsMin = glm::vec3(0.0f);
+		glm::vec3 boundsMax = glm::vec3(0.0f);
+		glm::vec4 boundingSphere = glm::vec4(0.0f);
+	};
+	// simplification target of each LOD after the first, the chain stops early once a level saves too little
+	struct LodTarget {
+		float triangleRatio;    // of the full mesh
+		float maxError;         // relative to the mesh extent
+	};
+	static const LodTarget lodTargets[];
+	static const unsigned int lodTargetCount;
+	// read only view of a mesh in the float layout, the storage is owned elsewhere
+	struct MeshView {
+		std::string name;
+		unsigned int materialID;
+		unsigned int vertexCount;
+		unsigned int indexCount;    // all LODs
+		const float *vertices;
+		const unsigned int *indices;
+		const Lod *lods;
+		unsigned int lodCount;
+		const Meshlet *meshlets;
+		unsigned int meshletCount;
+		glm::vec3 boundsMin;
+		glm::vec3 boundsMax;
+		glm::vec4 boundingSphere;
+	};
+	// Position in unorm16 relative to the model bounds, normal and tangent octahedral encoded in snorm16,
+	// uv in half floats. Shaders dequantize with positionScale/positionOffset and compactVertices.
+	struct CompactVertex {
+		uint16_t position[4];
+		int16_t normal[2];
+		uint16_t uv[2];
+		int16_t tangent[2];
+	};
+	struct CompactMeshData {
+		std::vector<CompactVertex> vertices;
+		std::vector<unsigned char> indices;  // 16 bit when the mesh has fewer than 65536 vertices
+		unsigned int indexCount = 0;
+		GLenum indexType = GL_UNSIGNED_INT;
+	};
+	// CPU side material, texture paths are relative to the model directory
+	struct MaterialData {
+		std::string texturePath;
+		std::string normalMapPath;
+		glm::vec3 ambientColor;
+		glm::vec3 diffuseColor;
+		glm::vec3 specularColor;
+		float shininess;
 	};
 	std::unordered_map<int, Material> materials;
 private:
+	struct SceneData;
+	struct StreamingState;
+	struct PendingImages {
+		std::future<std::shared_ptr<TextureBake>> texture;
+		std::future<std::shared_ptr<TextureBake>> normalMap;
+	};
+
+	// an Assimp mesh placed by the accumulated transform of the node that references it
+	struct SceneMesh {
+		const aiMesh *mesh;
+		aiMatrix4x4 transform;
+	};
 
 	std::string directory;
-	static Mesh processMesh(const aiMesh *mesh, const aiScene *scene);
-	void processNode(aiNode *node, const aiScene *scene);
-	void processMaterial(const aiScene *scene);
-	GLuint loadTexture(std::string const& pFile);
-	GLuint loadNormalMap(std::string const &pFile);
+	// raw triangles with the node transform baked into positions, normals and tangents
+	static MeshData processMesh(const aiMesh *mesh, const aiMatrix4x4 &transform);
+	// Static batching, concatenates the raw meshes that share a material into one mesh per material,
+	// in order of first use. Clusters keep culling at a finer grain than the merged meshes.
+	static std::vector<MeshData> batchByMaterial(std::vector<MeshData> &meshes);
+	// optimization, bounds and LODs of freshly imported triangles, whichever reader produced them
+	static void finishMesh(MeshData &meshData);
+	// parses and post-processes with importFlags, null after reporting the error
+	static const aiScene *readScene(Assimp::Importer &importer, const std::string &pFile);
+	static bool isObj(const std::string &pFile);
+	// the native reader for .obj files, false lets the caller fall back to Assimp
+	static bool importObj(const std::string &pFile, std::vector<MaterialData> &materialData,
+						  std::vector<ObjReader::Mesh> &meshes);
+	static MeshData objMesh(ObjReader::Mesh &mesh);
+	// vertex cache, overdraw and vertex fetch reordering, reports ACMR/ATVR before and after
+	static void optimizeMesh(MeshData &meshData);
+	static void buildLods(MeshData &meshData);
+	// splits the last level of meshData into clusters and records them in its Lod
+	static void buildMeshlets(MeshData &meshData);
+	// box and sphere of the vertex positions, SSE where available
+	static void computeBounds(MeshData &meshData);
+	// the model's volumes from those of its meshes
+	void updateBounds();
+	static void processNode(const aiNode *node, const aiScene *scene, const aiMatrix4x4 &parentTransform,
+							std::vector<SceneMesh> &sceneMeshes);
+	static void processMaterial(const aiScene *scene, std::vector<MaterialData> &materialData);
+	std::vector<GeometryArena::Allocation> allocations;
+	static void setVertexAttributes(VertexFormat format);
+	static size_t vertexStride(VertexFormat format);
+	static GeometryArena &geometryArena(VertexFormat format);
+	// places the mesh in the arena of this model's format, null data only reserves the space
+	Mesh uploadMesh(const MeshView &view, const void *vertices, const void *indices, GLenum indexType);
+	void uploadMeshes(const std::vector<MeshView> &views);
+	void uploadMeshlets();
+	static CompactMeshData compressMesh(const MeshView &view, glm::vec3 scale, glm::vec3 offset);
+	static void quantizationRange(const std::vector<MeshView> &views, glm::vec3 &scale, glm::vec3 &offset);
+	std::vector<PendingImages> acquireMaterials(const std::vector<MaterialData> &materialData);
+	void finishMaterials(const std::vector<MaterialData> &materialData, std::vector<PendingImages> &images);
+	bool loadFromCache(const std::string &cachePath, uint64_t sourceHash);
+	void load(std::string const &pFile);
+	// the baked mip chain of an image, null if it cannot be read
+	static std::shared_ptr<TextureBake> loadImage(const std::string &path, TextureBake::Usage usage);
+	// (re)specifies every level of the bound texture, null data only allocates them
+	static void specifyLevels(const TextureBake &bake, bool withData);
+	// trilinear over the baked chain, normal maps tile with plain repeat
+	static void setSampler(bool normalMap);
+	static void uploadTexture(GLuint textureID, const TextureBake &bake, std::string const &pFile);
+	static void uploadNormalMap(GLuint textureID, const TextureBake &bake, std::string const &pFile);
+	static bool importMeshes(std::string const &pFile, SceneData &sceneData);
+	static MeshView meshView(const MeshData &mesh);
+	static std::shared_ptr<SceneData> importScene(std::string const &pFile, std::string const &cachePath,
+												  VertexFormat format);
+	static std::vector<Model *> &streamingModels();
+	std::shared_ptr<StreamingState> streaming;
+	void beginStreaming();
+	void streamImages();
+	bool updateStreamingState();
 
 public:
 	std::vector<Mesh> meshes;
-	explicit Model(std::string const &pFile);
+	// clusters of every mesh, mirrored in meshletBuffer as std430 Meshlet records for shaders
+	std::vector<Meshlet> meshlets;
+	GLuint meshletBuffer = 0;
+	VertexFormat vertexFormat;
+	// object space position = attribute * positionScale + positionOffset, identity for VertexFormat::Float
+	glm::vec3 positionScale = glm::vec3(1.0f);
+	glm::vec3 positionOffset = glm::vec3(0.0f);
+	// object space volumes enclosing every mesh, known before a streamed model has finished uploading
+	glm::vec3 boundsMin = glm::vec3(0.0f);
+	glm::vec3 boundsMax = glm::vec3(0.0f);
+	glm::vec4 boundingSphere = glm::vec4(0.0f);
+	// a streamed model returns immediately, its meshes draw nothing and its textures are 1x1
+	// placeholders until updateStreaming has finished the uploads over the following frames
+	explicit Model(std::string const &pFile, bool stream = false, VertexFormat format = VertexFormat::Float);
+	~Model();
+
+	bool isLoaded() const { return !streaming; }
+	// advances every streaming model, call once per frame on the context thread
+	static void updateStreaming(size_t byteBudget);
+
+	// Coarsest LOD whose error projects to at most maxPixelError pixels from viewPosition.
+	// projectionScale is the viewport height divided by 2 tan(fovy / 2).
+	static unsigned int selectLod(const Mesh &mesh, const glm::mat4 &modelMatrix, const glm::vec3 &viewPosition,
+								  float projectionScale, float maxPixelError);
+
+	// world space volume clusters are tested against
+	struct ClusterView {
+		glm::vec4 planes[6];            // normalized, pointing inwards
+		unsigned int planeCount = 0;
+		glm::vec3 position = glm::vec3(0.0f);  // eye or light
+		float range = 0.0f;             // clusters entirely further away from position are culled, 0 disables
+		bool backfaceCulling = false;   // cone test from position, only valid for perspective projections
+		// the frustum planes of a view projection matrix
+		static ClusterView frustum(const glm::mat4 &viewProjection, const glm::vec3 &eye, bool backfaceCulling);
+		// every face of a cube map at once, a sphere around the light
+		static ClusterView sphere(const glm::vec3 &center, float radius);
+	};
+	// index ranges of the clusters that survived, ready for glMultiDrawElementsBaseVertex
+	struct ClusterDraws {
+		std::vector<GLsizei> counts;
+		std::vector<GLvoid *> offsets;
+		std::vector<GLint> baseVertices;
+		unsigned int visible = 0;
+		unsigned int total = 0;
+	};
+	// Replaces draws with the visible clusters of one LOD, neighbouring clusters merge into one range.
+	// modelMatrix is assumed to scale uniformly.
+	void cullClusters(const Mesh &mesh, unsigned int lod, const glm::mat4 &modelMatrix, const ClusterView &view,
+					  ClusterDraws &draws) const;
 };
 #endif //GRAPHICS_PROGRAMMING_MODEL_H
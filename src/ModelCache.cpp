@@ -0,0 +1,312 @@
+#include "ModelCache.h"
+
+#include <cctype>
+#include <cstring>
+#include <cstdio>
+
+namespace {
+    const char cacheMagic[4] = {'G', 'P', 'M', 'C'};
+    const uint64_t blobAlignment = 16;
+
+    struct Header {
+        char magic[4];
+        uint32_t version;
+        uint64_t sourceHash;
+        uint32_t meshCount;
+        uint32_t materialCount;
+        uint64_t fileSize;
+    };
+
+    struct MeshRecord {
+        uint32_t materialID;
+        uint32_t vertexCount;
+        uint32_t indexCount;
+        uint32_t nameLength;
+        uint64_t nameOffset;
+        uint64_t vertexOffset;
+        uint64_t indexOffset;
+        float boundsMin[3];
+        float boundsMax[3];
+        float boundingSphere[4];
+        uint32_t lodCount;
+        uint32_t meshletCount;
+        uint64_t lodOffset;
+        uint64_t meshletOffset;
+    };
+
+    struct MaterialRecord {
+        float ambientColor[3];
+        float diffuseColor[3];
+        float specularColor[3];
+        float shininess;
+        uint32_t textureLength;
+        uint32_t normalMapLength;
+        uint64_t textureOffset;
+        uint64_t normalMapOffset;
+    };
+
+    uint64_t align(uint64_t offset) {
+        return (offset + blobAlignment - 1) & ~(blobAlignment - 1);
+    }
+
+    // FNV-1a
+    uint64_t hashBytes(uint64_t hash, const unsigned char *data, size_t size) {
+        for (size_t i = 0; i < size; i++) {
+            hash ^= data[i];
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+
+    bool inRange(uint64_t offset, uint64_t size, uint64_t fileSize) {
+        return offset <= fileSize && size <= fileSize - offset;
+    }
+
+    std::string readString(const unsigned char *base, uint64_t offset, uint32_t length) {
+        return std::string(reinterpret_cast<const char *>(base + offset), length);
+    }
+}
+
+uint64_t ModelCache::hashSource(const std::string &pFile) {
+    uint64_t hash = 14695981039346656037ull;
+    MappedFile source(pFile);
+    if (!source.isOpen())
+        return hash;
+    hash = hashBytes(hash, source.data(), source.size());
+
+    std::string extension = pFile.substr(pFile.find_last_of('.') + 1);
+    if (extension != "obj" && extension != "OBJ")
+        return hash;
+
+    // fold in the material libraries, edits to an .mtl must invalidate the cache as well
+    std::string directory = pFile.substr(0, pFile.find_last_of('/'));
+    const char *text = reinterpret_cast<const char *>(source.data());
+    size_t size = source.size();
+    size_t lineStart = 0;
+    while (lineStart < size) {
+        const char *lineEnd = static_cast<const char *>(memchr(text + lineStart, '\n', size - lineStart));
+        size_t lineLength = lineEnd ? lineEnd - (text + lineStart) : size - lineStart;
+        if (lineLength > 7 && strncmp(text + lineStart, "mtllib", 6) == 0 && isspace((unsigned char)text[lineStart + 6])) {
+            std::string name(text + lineStart + 7, lineLength - 7);
+            name.erase(name.find_last_not_of(" \t\r") + 1);
+            name.erase(0, name.find_first_not_of(" \t"));
+            MappedFile library(directory + '/' + name);
+            if (library.isOpen())
+                hash = hashBytes(hash, library.data(), library.size());
+        }
+        lineStart += lineLength + 1;
+    }
+    return hash;
+}
+
+bool ModelCache::write(const std::string &cachePath, uint64_t sourceHash,
+                       const std::vector<Model::MeshData> &meshData,
+                       const std::vector<Model::MaterialData> &materialData) {
+    std::vector<MeshRecord> meshRecords(meshData.size());
+    std::vector<MaterialRecord> materialRecords(materialData.size());
+
+    // lay out records, then strings, then the 16 byte aligned blobs
+    uint64_t offset = sizeof(Header) + sizeof(MeshRecord) * meshRecords.size() +
+                      sizeof(MaterialRecord) * materialRecords.size();
+    for (size_t i = 0; i < meshData.size(); i++) {
+        meshRecords[i].materialID = meshData[i].materialID;
+        meshRecords[i].nameLength = (uint32_t) meshData[i].name.size();
+        meshRecords[i].nameOffset = offset;
+        offset += meshRecords[i].nameLength;
+    }
+    for (size_t i = 0; i < materialData.size(); i++) {
+        const Model::MaterialData &material = materialData[i];
+        MaterialRecord &record = materialRecords[i];
+        memcpy(record.ambientColor, glm::value_ptr(material.ambientColor), sizeof(record.ambientColor));
+        memcpy(record.diffuseColor, glm::value_ptr(material.diffuseColor), sizeof(record.diffuseColor));
+        memcpy(record.specularColor, glm::value_ptr(material.specularColor), sizeof(record.specularColor));
+        record.shininess = material.shininess;
+        record.textureLength = (uint32_t) material.texturePath.size();
+        record.textureOffset = offset;
+        offset += record.textureLength;
+        record.normalMapLength = (uint32_t) material.normalMapPath.size();
+        record.normalMapOffset = offset;
+        offset += record.normalMapLength;
+    }
+    for (size_t i = 0; i < meshData.size(); i++) {
+        meshRecords[i].vertexCount = (uint32_t) (meshData[i].vertices.size() / Model::MeshData::vertexSize);
+        meshRecords[i].indexCount = (uint32_t) meshData[i].indices.size();
+        offset = align(offset);
+        meshRecords[i].vertexOffset = offset;
+        offset += meshData[i].vertices.size() * sizeof(float);
+        offset = align(offset);
+        meshRecords[i].indexOffset = offset;
+        offset += meshData[i].indices.size() * sizeof(unsigned int);
+        memcpy(meshRecords[i].boundsMin, glm::value_ptr(meshData[i].boundsMin), sizeof(meshRecords[i].boundsMin));
+        memcpy(meshRecords[i].boundsMax, glm::value_ptr(meshData[i].boundsMax), sizeof(meshRecords[i].boundsMax));
+        memcpy(meshRecords[i].boundingSphere, glm::value_ptr(meshData[i].boundingSphere),
+               sizeof(meshRecords[i].boundingSphere));
+        meshRecords[i].lodCount = (uint32_t) meshData[i].lods.size();
+        offset = align(offset);
+        meshRecords[i].lodOffset = offset;
+        offset += meshData[i].lods.size() * sizeof(Model::Lod);
+        meshRecords[i].meshletCount = (uint32_t) meshData[i].meshlets.size();
+        offset = align(offset);
+        meshRecords[i].meshletOffset = offset;
+        offset += meshData[i].meshlets.size() * sizeof(Model::Meshlet);
+    }
+
+    Header header{};
+    memcpy(header.magic, cacheMagic, sizeof(cacheMagic));
+    header.version = version;
+    header.sourceHash = sourceHash;
+    header.meshCount = (uint32_t) meshRecords.size();
+    header.materialCount = (uint32_t) materialRecords.size();
+    header.fileSize = offset;
+
+    // write to a temporary file first so a crash never leaves a truncated cache behind
+    std::string tempPath = cachePath + ".tmp";
+    std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+    if (!out)
+        return false;
+
+    uint64_t written = 0;
+    auto put = [&](const void *data, uint64_t size) {
+        out.write(static_cast<const char *>(data), (std::streamsize) size);
+        written += size;
+    };
+    auto pad = [&]() {
+        static const char zeros[blobAlignment] = {};
+        put(zeros, align(written) - written);
+    };
+
+    put(&header, sizeof(header));
+    put(meshRecords.data(), sizeof(MeshRecord) * meshRecords.size());
+    put(materialRecords.data(), sizeof(MaterialRecord) * materialRecords.size());
+    for (auto &mesh: meshData)
+        put(mesh.name.data(), mesh.name.size());
+    for (auto &material: materialData) {
+        put(material.texturePath.data(), material.texturePath.size());
+        put(material.normalMapPath.data(), material.normalMapPath.size());
+    }
+    for (auto &mesh: meshData) {
+        pad();
+        put(mesh.vertices.data(), mesh.vertices.size() * sizeof(float));
+        pad();
+        put(mesh.indices.data(), mesh.indices.size() * sizeof(unsigned int));
+        pad();
+        put(mesh.lods.data(), mesh.lods.size() * sizeof(Model::Lod));
+        pad();
+        put(mesh.meshlets.data(), mesh.meshlets.size() * sizeof(Model::Meshlet));
+    }
+    out.close();
+    if (!out || written != header.fileSize) {
+        std::remove(tempPath.c_str());
+        return false;
+    }
+
+    std::remove(cachePath.c_str());
+    if (std::rename(tempPath.c_str(), cachePath.c_str()) != 0) {
+        std::remove(tempPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool ModelCache::open(const std::string &cachePath, uint64_t sourceHash) {
+    meshes.clear();
+    materials.clear();
+    if (!file.open(cachePath))
+        return false;
+    bool opened = parse(sourceHash);
+    if (!opened) {
+        // a stale cache stays unmapped so write can replace it
+        meshes.clear();
+        materials.clear();
+        file.close();
+    }
+    return opened;
+}
+
+bool ModelCache::parse(uint64_t sourceHash) {
+    const unsigned char *base = file.data();
+    uint64_t fileSize = file.size();
+    if (fileSize < sizeof(Header))
+        return false;
+
+    Header header{};
+    memcpy(&header, base, sizeof(header));
+    if (memcmp(header.magic, cacheMagic, sizeof(cacheMagic)) != 0 || header.version != version ||
+        header.sourceHash != sourceHash || header.fileSize != fileSize)
+        return false;
+
+    uint64_t recordsSize = sizeof(MeshRecord) * (uint64_t) header.meshCount +
+                           sizeof(MaterialRecord) * (uint64_t) header.materialCount;
+    if (!inRange(sizeof(Header), recordsSize, fileSize))
+        return false;
+
+    const auto *meshRecords = reinterpret_cast<const MeshRecord *>(base + sizeof(Header));
+    const auto *materialRecords = reinterpret_cast<const MaterialRecord *>(meshRecords + header.meshCount);
+
+    for (uint32_t i = 0; i < header.meshCount; i++) {
+        const MeshRecord &record = meshRecords[i];
+        uint64_t vertexBytes = (uint64_t) record.vertexCount * Model::MeshData::vertexSize * sizeof(float);
+        uint64_t indexBytes = (uint64_t) record.indexCount * sizeof(unsigned int);
+        uint64_t lodBytes = (uint64_t) record.lodCount * sizeof(Model::Lod);
+        uint64_t meshletBytes = (uint64_t) record.meshletCount * sizeof(Model::Meshlet);
+        if (!inRange(record.nameOffset, record.nameLength, fileSize) ||
+            !inRange(record.vertexOffset, vertexBytes, fileSize) ||
+            !inRange(record.indexOffset, indexBytes, fileSize) ||
+            !inRange(record.lodOffset, lodBytes, fileSize) || record.lodCount == 0 ||
+            !inRange(record.meshletOffset, meshletBytes, fileSize) ||
+            record.vertexOffset % blobAlignment != 0 || record.indexOffset % blobAlignment != 0 ||
+            record.lodOffset % blobAlignment != 0 || record.meshletOffset % blobAlignment != 0) {
+            meshes.clear();
+            return false;
+        }
+        const auto *lods = reinterpret_cast<const Model::Lod *>(base + record.lodOffset);
+        const auto *meshlets = reinterpret_cast<const Model::Meshlet *>(base + record.meshletOffset);
+        bool valid = true;
+        for (uint32_t lod = 0; lod < record.lodCount; lod++) {
+            valid = valid && inRange(lods[lod].indexOffset, lods[lod].indexCount, record.indexCount) &&
+                    inRange(lods[lod].meshletOffset, lods[lod].meshletCount, record.meshletCount);
+        }
+        for (uint32_t meshlet = 0; meshlet < record.meshletCount; meshlet++) {
+            valid = valid && inRange(meshlets[meshlet].indexOffset, (uint64_t) meshlets[meshlet].triangleCount * 3,
+                                     record.indexCount);
+        }
+        if (!valid) {
+            meshes.clear();
+            return false;
+        }
+        meshes.push_back(MeshView{
+                readString(base, record.nameOffset, record.nameLength),
+                record.materialID,
+                record.vertexCount,
+                record.indexCount,
+                reinterpret_cast<const float *>(base + record.vertexOffset),
+                reinterpret_cast<const unsigned int *>(base + record.indexOffset),
+                lods,
+                record.lodCount,
+                meshlets,
+                record.meshletCount,
+                glm::make_vec3(record.boundsMin),
+                glm::make_vec3(record.boundsMax),
+                glm::make_vec4(record.boundingSphere)
+        });
+    }
+
+    for (uint32_t i = 0; i < header.materialCount; i++) {
+        const MaterialRecord &record = materialRecords[i];
+        if (!inRange(record.textureOffset, record.textureLength, fileSize) ||
+            !inRange(record.normalMapOffset, record.normalMapLength, fileSize)) {
+            meshes.clear();
+            materials.clear();
+            return false;
+        }
+        Model::MaterialData material;
+        material.texturePath = readString(base, record.textureOffset, record.textureLength);
+        material.normalMapPath = readString(base, record.normalMapOffset, record.normalMapLength);
+        material.ambientColor = glm::make_vec3(record.ambientColor);
+        material.diffuseColor = glm::make_vec3(record.diffuseColor);
+        material.specularColor = glm::make_vec3(record.specularColor);
+        material.shininess = record.shininess;
+        materials.push_back(material);
+    }
+    return true;
+}
@@ -0,0 +1,39 @@
+#ifndef GRAPHICS_PROGRAMMING_MODEL_CACHE_H
+#define GRAPHICS_PROGRAMMING_MODEL_CACHE_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include "Model.h"
+#include "MappedFile.h"
+
+// Baked binary form of an imported model.
+// Written after the first import and memory mapped on later runs, so vertex and index
+// blobs can be handed to glBufferData straight from the mapped file.
+class ModelCache
+{
+public:
+    static const uint32_t version = 9;
+
+    typedef Model::MeshView MeshView;
+
+    std::vector<MeshView> meshes;
+    std::vector<Model::MaterialData> materials;
+
+    // content hash of the model file and, for .obj, every mtllib it references
+    static uint64_t hashSource(const std::string& pFile);
+
+    static bool write(const std::string& cachePath, uint64_t sourceHash,
+                      const std::vector<Model::MeshData>& meshData,
+                      const std::vector<Model::MaterialData>& materialData);
+
+    // maps the cache, fails if it is missing, malformed or baked from a different source
+    bool open(const std::string& cachePath, uint64_t sourceHash);
+
+private:
+    MappedFile file;
+
+    bool parse(uint64_t sourceHash);
+};
+#endif //GRAPHICS_PROGRAMMING_MODEL_CACHE_H
@@ -0,0 +1,639 @@
+#include "ObjReader.h"
+#include "MappedFile.h"
+#include "ThreadPool.h"
+
+#include <cmath>
+#include <cstring>
+#include <cstdint>
+#include <climits>
+#include <iostream>
+#include <algorithm>
+#include <unordered_map>
+
+namespace {
+    // large enough that the per chunk bookkeeping vanishes, small enough to balance a few MB over every worker
+    const size_t chunkSize = 1 << 20;
+    const int missing = INT_MIN;
+
+    // 0 based indices into the file wide pools once the chunk is merged
+    struct Corner {
+        int position;
+        int texcoord;
+        int normal;
+    };
+
+    // usemtl, o or g, in effect from triangle on
+    struct Switch {
+        bool material;
+        std::string name;
+        size_t triangle;
+    };
+
+    struct Chunk {
+        std::vector<float> positions;
+        std::vector<float> texcoords;
+        std::vector<float> normals;
+        std::vector<Corner> corners;        // three per triangle
+        std::vector<Switch> switches;
+        // slots (corner * 3 + attribute) holding a negative OBJ index, relative to this chunk until merged
+        std::vector<size_t> relative;
+        std::vector<std::string> libraries;
+        size_t positionBase = 0;
+        size_t texcoordBase = 0;
+        size_t normalBase = 0;
+        bool valid = true;
+    };
+
+    // a run of triangles of one chunk
+    struct Range {
+        size_t chunk;
+        size_t begin;
+        size_t end;
+    };
+
+    struct Group {
+        std::string object;
+        unsigned int material;
+        std::vector<Range> ranges;
+    };
+
+    const double powersOf10[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14,
+                                 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+    bool isSpace(char c) {
+        return c == ' ' || c == '\t' || c == '\r';
+    }
+
+    bool isDigit(char c) {
+        return c >= '0' && c <= '9';
+    }
+
+    const char *skipSpace(const char *p, const char *end) {
+        while (p < end && isSpace(*p))
+            p++;
+        return p;
+    }
+
+    // the rest of the line without surrounding blanks
+    std::string rest(const char *p, const char *end) {
+        p = skipSpace(p, end);
+        while (end > p && isSpace(end[-1]))
+            end--;
+        return std::string(p, end);
+    }
+
+    bool keyword(const char *p, const char *end, const char *word) {
+        size_t length = strlen(word);
+        return (size_t) (end - p) >= length && memcmp(p, word, length) == 0 &&
+               ((size_t) (end - p) == length || isSpace(p[length]));
+    }
+
+    // Decimal mantissa and exponent, then one multiplication or division in double. That is exact for up to
+    // 19 significant digits and exponents within 10^22, which covers anything an exporter writes, before the
+    // final rounding to float. Returns null if there is no number.
+    const char *parseFloat(const char *p, const char *end, float &value) {
+        p = skipSpace(p, end);
+        bool negative = false;
+        if (p < end && (*p == '-' || *p == '+'))
+            negative = *p++ == '-';
+        uint64_t mantissa = 0;
+        int exponent = 0, digits = 0;
+        bool any = false;
+        for (; p < end && isDigit(*p); p++) {
+            any = true;
+            if (digits < 19) {
+                mantissa = mantissa * 10 + (*p - '0');
+                digits += mantissa != 0;
+            } else {
+                exponent++;
+            }
+        }
+        if (p < end && *p == '.') {
+            for (p++; p < end && isDigit(*p); p++) {
+                any = true;
+                if (digits < 19) {
+                    mantissa = mantissa * 10 + (*p - '0');
+                    digits += mantissa != 0;
+                    exponent--;
+                }
+            }
+        }
+        if (!any)
+            return nullptr;
+        if (p < end && (*p == 'e' || *p == 'E')) {
+            const char *q = p + 1;
+            bool negativeExponent = false;
+            if (q < end && (*q == '-' || *q == '+'))
+                negativeExponent = *q++ == '-';
+            int written = 0;
+            bool exponentDigits = false;
+            for (; q < end && isDigit(*q); q++) {
+                exponentDigits = true;
+                written = std::min(written * 10 + (*q - '0'), 100000);
+            }
+            if (exponentDigits) {
+                exponent += negativeExponent ? -written : written;
+                p = q;
+            }
+        }
+        double result = (double) mantissa;
+        if (exponent < 0)
+            result = exponent >= -22 ? result / powersOf10[-exponent] : result * std::pow(10.0, exponent);
+        else if (exponent > 0)
+            result = exponent <= 22 ? result * powersOf10[exponent] : result * std::pow(10.0, exponent);
+        value = (float) (negative ? -result : result);
+        return p;
+    }
+
+    const char *parseIndex(const char *p, const char *end, long &value) {
+        bool negative = false;
+        if (p < end && (*p == '-' || *p == '+'))
+            negative = *p++ == '-';
+        if (p >= end || !isDigit(*p))
+            return nullptr;
+        value = 0;
+        for (; p < end && isDigit(*p); p++)
+            value = std::min(value * 10 + (*p - '0'), (long) INT_MAX);
+        if (negative)
+            value = -value;
+        return p;
+    }
+
+    // up to count floats, the ones the line leaves out keep their defaults
+    void parseFloats(const char *p, const char *end, float *values, int count) {
+        for (int i = 0; i < count && p; i++) {
+            float value;
+            p = parseFloat(p, end, value);
+            if (p)
+                values[i] = value;
+        }
+    }
+
+    void parseFace(const char *p, const char *end, Chunk &chunk, std::vector<Corner> &polygon,
+                   std::vector<unsigned char> &polygonRelative) {
+        polygon.clear();
+        polygonRelative.clear();
+        size_t counts[3] = {chunk.positions.size() / 3, chunk.texcoords.size() / 2, chunk.normals.size() / 3};
+        while (true) {
+            p = skipSpace(p, end);
+            if (p >= end)
+                break;
+            int values[3] = {missing, missing, missing};
+            unsigned char relative = 0;
+            for (int attribute = 0; attribute < 3; attribute++) {
+                if (attribute > 0) {
+                    if (p >= end || *p != '/')
+                        break;
+                    p++;
+                    // p//n leaves the uv out
+                    if (p < end && *p == '/')
+                        continue;
+                }
+                long raw;
+                const char *next = parseIndex(p, end, raw);
+                // only the position is mandatory, index 0 does not exist
+                if (!next && attribute > 0)
+                    break;
+                if (!next || raw == 0) {
+                    chunk.valid = false;
+                    return;
+                }
+                p = next;
+                if (raw > 0) {
+                    values[attribute] = (int) (raw - 1);
+                } else {
+                    values[attribute] = (int) ((long) counts[attribute] + raw);
+                    relative |= 1 << attribute;
+                }
+            }
+            // anything after the last index of a corner is ignored
+            while (p < end && !isSpace(*p))
+                p++;
+            polygon.push_back(Corner{values[0], values[1], values[2]});
+            polygonRelative.push_back(relative);
+        }
+
+        // fanned like Assimp's triangulation, which is exact for the convex polygons exporters write
+        for (size_t i = 2; i < polygon.size(); i++) {
+            const size_t fan[3] = {0, i - 1, i};
+            for (size_t corner: fan) {
+                if (polygonRelative[corner]) {
+                    for (int attribute = 0; attribute < 3; attribute++) {
+                        if (polygonRelative[corner] & (1 << attribute))
+                            chunk.relative.push_back(chunk.corners.size() * 3 + attribute);
+                    }
+                }
+                chunk.corners.push_back(polygon[corner]);
+            }
+        }
+    }
+
+    void parseChunk(const char *begin, const char *end, Chunk &chunk) {
+        std::vector<Corner> polygon;
+        std::vector<unsigned char> polygonRelative;
+        const char *line = begin;
+        while (line < end) {
+            const char *lineEnd = static_cast<const char *>(memchr(line, '\n', end - line));
+            if (!lineEnd)
+                lineEnd = end;
+            const char *p = skipSpace(line, lineEnd);
+            if (p + 1 < lineEnd) {
+                if (p[0] == 'v' && isSpace(p[1])) {
+                    float position[3] = {0.0f, 0.0f, 0.0f};
+                    parseFloats(p + 1, lineEnd, position, 3);
+                    chunk.positions.insert(chunk.positions.end(), position, position + 3);
+                } else if (keyword(p, lineEnd, "vt")) {
+                    float texcoord[2] = {0.0f, 0.0f};
+                    parseFloats(p + 2, lineEnd, texcoord, 2);
+                    chunk.texcoords.insert(chunk.texcoords.end(), texcoord, texcoord + 2);
+                } else if (keyword(p, lineEnd, "vn")) {
+                    float normal[3] = {0.0f, 0.0f, 0.0f};
+                    parseFloats(p + 2, lineEnd, normal, 3);
+                    chunk.normals.insert(chunk.normals.end(), normal, normal + 3);
+                } else if (p[0] == 'f' && isSpace(p[1])) {
+                    parseFace(p + 1, lineEnd, chunk, polygon, polygonRelative);
+                } else if ((p[0] == 'o' || p[0] == 'g') && isSpace(p[1])) {
+                    chunk.switches.push_back(Switch{false, rest(p + 1, lineEnd), chunk.corners.size() / 3});
+                } else if (keyword(p, lineEnd, "usemtl")) {
+                    chunk.switches.push_back(Switch{true, rest(p + 6, lineEnd), chunk.corners.size() / 3});
+                } else if (keyword(p, lineEnd, "mtllib")) {
+                    chunk.libraries.push_back(rest(p + 6, lineEnd));
+                }
+            }
+            line = lineEnd + 1;
+        }
+    }
+
+    ObjReader::Material defaultMaterial(const std::string &name) {
+        return ObjReader::Material{name, {0.0f, 0.0f, 0.0f}, {0.6f, 0.6f, 0.6f}, {0.0f, 0.0f, 0.0f}, 0.0f, "", ""};
+    }
+
+    // texture statements may carry options before the file name, which itself may contain spaces
+    std::string mapPath(const char *p, const char *end) {
+        p = skipSpace(p, end);
+        while (p < end && *p == '-') {
+            while (p < end && !isSpace(*p))
+                p++;
+            // option arguments are numbers, on/off or a single channel letter
+            while (true) {
+                const char *argument = skipSpace(p, end), *argumentEnd = argument;
+                while (argumentEnd < end && !isSpace(*argumentEnd))
+                    argumentEnd++;
+                std::string word(argument, argumentEnd);
+                float number;
+                const char *parsed = parseFloat(argument, argumentEnd, number);
+                if (word.empty() || !((parsed && parsed == argumentEnd) || word == "on" || word == "off" ||
+                                      word.size() == 1))
+                    break;
+                p = argumentEnd;
+            }
+            p = skipSpace(p, end);
+        }
+        return rest(p, end);
+    }
+
+    void readLibrary(const std::string &path, std::vector<ObjReader::Material> &materials) {
+        MappedFile file(path);
+        if (!file.isOpen()) {
+            std::cout << "Failed to open material library: " << path << std::endl;
+            return;
+        }
+        const char *line = reinterpret_cast<const char *>(file.data());
+        const char *end = line + file.size();
+        ObjReader::Material *material = nullptr;
+        while (line < end) {
+            const char *lineEnd = static_cast<const char *>(memchr(line, '\n', end - line));
+            if (!lineEnd)
+                lineEnd = end;
+            const char *p = skipSpace(line, lineEnd);
+            if (keyword(p, lineEnd, "newmtl")) {
+                materials.push_back(defaultMaterial(rest(p + 6, lineEnd)));
+                material = &materials.back();
+            } else if (material) {
+                float *color = keyword(p, lineEnd, "Ka") ? material->ambient :
+                               keyword(p, lineEnd, "Kd") ? material->diffuse :
+                               keyword(p, lineEnd, "Ks") ? material->specular : nullptr;
+                if (color) {
+                    float values[3] = {-1.0f, -1.0f, -1.0f};
+                    parseFloats(p + 2, lineEnd, values, 3);
+                    // a single value is a grey
+                    for (int i = 0; i < 3; i++)
+                        color[i] = values[i] >= 0.0f ? values[i] : values[0] >= 0.0f ? values[0] : color[i];
+                } else if (keyword(p, lineEnd, "Ns")) {
+                    parseFloats(p + 2, lineEnd, &material->shininess, 1);
+                } else if (keyword(p, lineEnd, "map_Kd")) {
+                    material->diffuseMap = mapPath(p + 6, lineEnd);
+                } else if (keyword(p, lineEnd, "map_Bump") || keyword(p, lineEnd, "map_bump")) {
+                    material->bumpMap = mapPath(p + 8, lineEnd);
+                } else if (keyword(p, lineEnd, "bump")) {
+                    material->bumpMap = mapPath(p + 4, lineEnd);
+                }
+            }
+            line = lineEnd + 1;
+        }
+    }
+
+    bool inRange(int index, size_t count) {
+        return index >= 0 && (size_t) index < count;
+    }
+
+    void buildMesh(const Group &group, const std::vector<Chunk> &chunks, const std::vector<float> &positions,
+                   const std::vector<float> &texcoords, const std::vector<float> &normals, ObjReader::Mesh &mesh) {
+        const unsigned int vsize = ObjReader::vertexSize;
+        mesh.name = group.object;
+        mesh.materialID = group.material;
+
+        int lowest = INT_MAX, highest = INT_MIN;
+        size_t triangleCount = 0;
+        bool hasTexcoords = false;
+        for (const Range &range: group.ranges) {
+            triangleCount += range.end - range.begin;
+            for (size_t i = range.begin * 3; i < range.end * 3; i++) {
+                const Corner &corner = chunks[range.chunk].corners[i];
+                lowest = std::min(lowest, corner.position);
+                highest = std::max(highest, corner.position);
+                hasTexcoords = hasTexcoords || corner.texcoord != missing;
+            }
+        }
+
+        // identical corners weld, candidates are chained per position index, the first occurrence wins
+        std::vector<int> head((size_t) (highest - lowest + 1), -1);
+        std::vector<int> next;
+        std::vector<Corner> sources;
+        mesh.indices.reserve(triangleCount * 3);
+        for (const Range &range: group.ranges) {
+            for (size_t i = range.begin * 3; i < range.end * 3; i++) {
+                const Corner &corner = chunks[range.chunk].corners[i];
+                int &chain = head[corner.position - lowest];
+                int vertex = -1;
+                // a corner without a normal gets the normal of its face, it welds once that is known
+                if (corner.normal != missing) {
+                    for (vertex = chain; vertex >= 0; vertex = next[vertex]) {
+                        if (sources[vertex].texcoord == corner.texcoord && sources[vertex].normal == corner.normal)
+                            break;
+                    }
+                }
+                if (vertex < 0) {
+                    vertex = (int) sources.size();
+                    sources.push_back(corner);
+                    next.push_back(chain);
+                    chain = vertex;
+                }
+                mesh.indices.push_back((unsigned int) vertex);
+            }
+        }
+
+        mesh.vertices.assign(sources.size() * vsize, 0.0f);
+        for (size_t v = 0; v < sources.size(); v++) {
+            float *vertex = &mesh.vertices[v * vsize];
+            const Corner &source = sources[v];
+            memcpy(vertex, &positions[(size_t) source.position * 3], sizeof(float) * 3);
+            if (source.normal != missing)
+                memcpy(vertex + 3, &normals[(size_t) source.normal * 3], sizeof(float) * 3);
+            if (source.texcoord != missing) {
+                vertex[6] = texcoords[(size_t) source.texcoord * 2];
+                vertex[7] = 1.0f - texcoords[(size_t) source.texcoord * 2 + 1];
+            }
+        }
+
+        // face normals where the file has none
+        bool generated = false;
+        for (size_t i = 0; i < mesh.indices.size(); i += 3) {
+            float *v[3];
+            for (int k = 0; k < 3; k++)
+                v[k] = &mesh.vertices[(size_t) mesh.indices[i + k] * vsize];
+            float e1[3], e2[3];
+            for (int c = 0; c < 3; c++) {
+                e1[c] = v[1][c] - v[0][c];
+                e2[c] = v[2][c] - v[0][c];
+            }
+            float face[3] = {e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0]};
+            float length = std::sqrt(face[0] * face[0] + face[1] * face[1] + face[2] * face[2]);
+            if (length > 0.0f) {
+                for (float &c: face)
+                    c /= length;
+            } else {
+                face[0] = face[1] = 0.0f;
+                face[2] = 1.0f;
+            }
+            for (int k = 0; k < 3; k++) {
+                if (sources[mesh.indices[i + k]].normal == missing) {
+                    memcpy(v[k] + 3, face, sizeof(face));
+                    generated = true;
+                }
+            }
+        }
+
+        // Those corners weld once they have their face normal, so coplanar neighbours share a vertex like
+        // after Assimp's JoinIdenticalVertices, with its tolerance on the normal. Vertices are compacted in place,
+        // the chains are rebuilt over the kept ones.
+        if (generated) {
+            const float squareEpsilon = 1e-5f * 1e-5f;
+            std::fill(head.begin(), head.end(), -1);
+            std::vector<unsigned int> remap(sources.size());
+            size_t kept = 0;
+            for (size_t v = 0; v < sources.size(); v++) {
+                int &chain = head[sources[v].position - lowest];
+                int vertex = -1;
+                if (sources[v].normal == missing) {
+                    const float *normal = &mesh.vertices[v * vsize + 3];
+                    for (vertex = chain; vertex >= 0; vertex = next[vertex]) {
+                        const float *other = &mesh.vertices[(size_t) vertex * vsize + 3];
+                        float dx = normal[0] - other[0], dy = normal[1] - other[1], dz = normal[2] - other[2];
+                        if (sources[vertex].texcoord == sources[v].texcoord &&
+                            dx * dx + dy * dy + dz * dz <= squareEpsilon)
+                            break;
+                    }
+                }
+                if (vertex < 0) {
+                    vertex = (int) kept++;
+                    if ((size_t) vertex != v) {
+                        memcpy(&mesh.vertices[(size_t) vertex * vsize], &mesh.vertices[v * vsize], sizeof(float) * vsize);
+                        sources[vertex] = sources[v];
+                    }
+                    if (sources[vertex].normal == missing) {
+                        next[vertex] = chain;
+                        chain = vertex;
+                    }
+                }
+                remap[v] = (unsigned int) vertex;
+            }
+            mesh.vertices.resize(kept * vsize);
+            sources.resize(kept);
+            for (unsigned int &index: mesh.indices)
+                index = remap[index];
+        }
+        if (!hasTexcoords)
+            return;
+
+        // tangents from the uv gradients
+        std::vector<float> tangents(sources.size() * 3, 0.0f);
+        for (size_t i = 0; i < mesh.indices.size(); i += 3) {
+            float *v[3];
+            for (int k = 0; k < 3; k++)
+                v[k] = &mesh.vertices[(size_t) mesh.indices[i + k] * vsize];
+            float e1[3], e2[3];
+            for (int c = 0; c < 3; c++) {
+                e1[c] = v[1][c] - v[0][c];
+                e2[c] = v[2][c] - v[0][c];
+            }
+            float du1 = v[1][6] - v[0][6], dv1 = v[1][7] - v[0][7];
+            float du2 = v[2][6] - v[0][6], dv2 = v[2][7] - v[0][7];
+            float determinant = du1 * dv2 - du2 * dv1;
+            if (determinant == 0.0f)
+                continue;
+            float r = 1.0f / determinant;
+            for (int k = 0; k < 3; k++) {
+                float *tangent = &tangents[(size_t) mesh.indices[i + k] * 3];
+                for (int c = 0; c < 3; c++)
+                    tangent[c] += (e1[c] * dv2 - e2[c] * dv1) * r;
+            }
+        }
+
+        // Gram-Schmidt against the normal, a degenerate uv mapping falls back to any perpendicular
+        for (size_t v = 0; v < sources.size(); v++) {
+            float *vertex = &mesh.vertices[v * vsize];
+            const float *n = vertex + 3;
+            float *t = &tangents[v * 3];
+            float d = n[0] * t[0] + n[1] * t[1] + n[2] * t[2];
+            for (int c = 0; c < 3; c++)
+                t[c] -= n[c] * d;
+            float length = std::sqrt(t[0] * t[0] + t[1] * t[1] + t[2] * t[2]);
+            if (length < 1e-12f) {
+                bool useX = std::abs(n[0]) < 0.9f;
+                float axis[3] = {useX ? 1.0f : 0.0f, useX ? 0.0f : 1.0f, 0.0f};
+                d = n[0] * axis[0] + n[1] * axis[1];
+                for (int c = 0; c < 3; c++)
+                    t[c] = axis[c] - n[c] * d;
+                length = std::sqrt(t[0] * t[0] + t[1] * t[1] + t[2] * t[2]);
+            }
+            for (int c = 0; c < 3; c++)
+                vertex[8 + c] = length > 0.0f ? t[c] / length : 0.0f;
+        }
+    }
+}
+
+bool ObjReader::read(const std::string &path) {
+    materials.clear();
+    meshes.clear();
+    MappedFile file(path);
+    if (!file.isOpen())
+        return false;
+
+    // line aligned chunks, a line never straddles two of them
+    const char *text = reinterpret_cast<const char *>(file.data());
+    const char *end = text + file.size();
+    std::vector<const char *> boundaries(1, text);
+    while (boundaries.back() < end) {
+        const char *split = std::min(boundaries.back() + chunkSize, end);
+        const char *newline = static_cast<const char *>(memchr(split, '\n', end - split));
+        boundaries.push_back(newline ? newline + 1 : end);
+    }
+    std::vector<Chunk> chunks(boundaries.size() - 1);
+    ThreadPool &pool = ThreadPool::shared();
+    pool.parallelFor(chunks.size(), [&](size_t i) {
+        parseChunk(boundaries[i], boundaries[i + 1], chunks[i]);
+    });
+
+    // pools concatenate in file order
+    size_t positionCount = 0, texcoordCount = 0, normalCount = 0;
+    for (Chunk &chunk: chunks) {
+        chunk.positionBase = positionCount;
+        chunk.texcoordBase = texcoordCount;
+        chunk.normalBase = normalCount;
+        positionCount += chunk.positions.size() / 3;
+        texcoordCount += chunk.texcoords.size() / 2;
+        normalCount += chunk.normals.size() / 3;
+    }
+    std::vector<float> positions(positionCount * 3), texcoords(texcoordCount * 2), normals(normalCount * 3);
+    pool.parallelFor(chunks.size(), [&](size_t i) {
+        Chunk &chunk = chunks[i];
+        std::copy(chunk.positions.begin(), chunk.positions.end(), positions.begin() + chunk.positionBase * 3);
+        std::copy(chunk.texcoords.begin(), chunk.texcoords.end(), texcoords.begin() + chunk.texcoordBase * 2);
+        std::copy(chunk.normals.begin(), chunk.normals.end(), normals.begin() + chunk.normalBase * 3);
+        std::vector<float>().swap(chunk.positions);
+        std::vector<float>().swap(chunk.texcoords);
+        std::vector<float>().swap(chunk.normals);
+
+        const size_t bases[3] = {chunk.positionBase, chunk.texcoordBase, chunk.normalBase};
+        for (size_t slot: chunk.relative) {
+            int *values = &chunk.corners[slot / 3].position;
+            values[slot % 3] += (int) bases[slot % 3];
+        }
+        for (const Corner &corner: chunk.corners) {
+            chunk.valid = chunk.valid && inRange(corner.position, positionCount) &&
+                          (corner.texcoord == missing || inRange(corner.texcoord, texcoordCount)) &&
+                          (corner.normal == missing || inRange(corner.normal, normalCount));
+        }
+    });
+    for (const Chunk &chunk: chunks) {
+        if (!chunk.valid) {
+            std::cout << "OBJ face refers to a missing vertex: " << path << std::endl;
+            return false;
+        }
+    }
+
+    std::string directory = path.substr(0, path.find_last_of('/') + 1);
+    materials.push_back(defaultMaterial("DefaultMaterial"));
+    std::vector<std::string> libraries;
+    for (const Chunk &chunk: chunks) {
+        for (const std::string &library: chunk.libraries) {
+            if (std::find(libraries.begin(), libraries.end(), library) != libraries.end())
+                continue;
+            libraries.push_back(library);
+            readLibrary(directory + library, materials);
+        }
+    }
+    std::unordered_map<std::string, unsigned int> materialIndex;
+    for (unsigned int i = (unsigned int) materials.size(); i-- > 0;)
+        materialIndex[materials[i].name] = i;
+
+    // one mesh per object and material, ordered by first use, triangles keep their file order
+    std::vector<Group> groups;
+    std::unordered_map<std::string, size_t> groupIndex;
+    std::string object = "defaultobject";
+    unsigned int material = 0;
+    for (size_t c = 0; c < chunks.size(); c++) {
+        size_t start = 0;
+        auto flush = [&](size_t triangle) {
+            if (triangle > start) {
+                std::string key = object + '\n' + std::to_string(material);
+                auto found = groupIndex.find(key);
+                if (found == groupIndex.end()) {
+                    found = groupIndex.emplace(key, groups.size()).first;
+                    groups.push_back(Group{object, material, {}});
+                }
+                groups[found->second].ranges.push_back(Range{c, start, triangle});
+            }
+            start = triangle;
+        };
+        for (const Switch &change: chunks[c].switches) {
+            flush(change.triangle);
+            if (!change.material) {
+                object = change.name;
+                continue;
+            }
+            auto found = materialIndex.find(change.name);
+            if (found == materialIndex.end()) {
+                // Assimp makes a default material for names no library defines
+                found = materialIndex.emplace(change.name, (unsigned int) materials.size()).first;
+                materials.push_back(defaultMaterial(change.name));
+            }
+            material = found->second;
+        }
+        flush(chunks[c].corners.size() / 3);
+    }
+
+    meshes.resize(groups.size());
+    pool.parallelFor(groups.size(), [&](size_t i) {
+        buildMesh(groups[i], chunks, positions, texcoords, normals, meshes[i]);
+    });
+    return true;
+}
+
+size_t ObjReader::triangleCount() const {
+    size_t count = 0;
+    for (const Mesh &mesh: meshes)
+        count += mesh.indices.size() / 3;
+    return count;
+}
@@ -0,0 +1,47 @@
+#ifndef GRAPHICS_PROGRAMMING_OBJ_READER_H
+#define GRAPHICS_PROGRAMMING_OBJ_READER_H
+
+#include <string>
+#include <vector>
+#include <cstddef>
+
+// Native Wavefront OBJ/MTL reader, the fast path Model takes for .obj files instead of Assimp.
+// The file is memory mapped and split into line aligned chunks that are parsed on the ThreadPool, the per chunk
+// pools are then concatenated in file order, so the result does not depend on the thread count.
+// Output matches what Model gets from Assimp with Triangulate, GenNormals, FlipUVs and CalcTangentSpace:
+// polygons are fanned, missing normals become face normals, v is flipped and tangents follow the uvs.
+// Corners with the same position, uv and normal share a vertex.
+class ObjReader
+{
+public:
+    // interleaved position, normal, uv, tangent like Model::MeshData
+    static const unsigned int vertexSize = 11;
+
+    struct Material {
+        std::string name;
+        float ambient[3];
+        float diffuse[3];
+        float specular[3];
+        float shininess;
+        std::string diffuseMap;     // map_Kd
+        std::string bumpMap;        // map_Bump or bump, relative to the OBJ directory
+    };
+
+    // the faces of one object with one material
+    struct Mesh {
+        std::string name;
+        unsigned int materialID;
+        std::vector<float> vertices;
+        std::vector<unsigned int> indices;
+    };
+
+    // index 0 is the default material, used by faces without a known usemtl
+    std::vector<Material> materials;
+    std::vector<Mesh> meshes;
+
+    // false if the file cannot be mapped or a face refers to a vertex that does not exist
+    bool read(const std::string& path);
+
+    size_t triangleCount() const;
+};
+#endif //GRAPHICS_PROGRAMMING_OBJ_READER_H
@@ -0,0 +1,128 @@
+#include "ProgramCache.h"
+#include "MappedFile.h"
+
+#include <cstring>
+#include <cstdio>
+#include <fstream>
+
+namespace {
+    const char cacheMagic[4] = {'G', 'P', 'P', 'C'};
+
+    struct Header {
+        char magic[4];
+        uint32_t version;
+        uint64_t key;
+        uint32_t binaryFormat;
+        uint32_t binaryLength;
+    };
+
+    // FNV-1a
+    uint64_t hashBytes(uint64_t hash, const void *data, size_t size) {
+        const auto *bytes = static_cast<const unsigned char *>(data);
+        for (size_t i = 0; i < size; i++) {
+            hash ^= bytes[i];
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+
+    // length first so the concatenation of neighbouring strings stays unambiguous
+    uint64_t hashString(uint64_t hash, const char *text) {
+        size_t length = text ? strlen(text) : 0;
+        hash = hashBytes(hash, &length, sizeof(length));
+        return hashBytes(hash, text, length);
+    }
+
+    std::string fileName(const std::string &path) {
+        size_t slash = path.find_last_of("/\\");
+        return slash == std::string::npos ? path : path.substr(slash + 1);
+    }
+}
+
+std::string ProgramCache::cachePath(const std::vector<const char *> &stagePaths, const std::string &defines) {
+    std::string path;
+    for (const char *stagePath: stagePaths) {
+        if (!stagePath)
+            continue;
+        path += path.empty() ? std::string(stagePath) : '+' + fileName(stagePath);
+    }
+    if (!defines.empty()) {
+        char suffix[18];
+        snprintf(suffix, sizeof(suffix), ".%016llx",
+                 (unsigned long long) hashString(14695981039346656037ull, defines.c_str()));
+        path += suffix;
+    }
+    return path + ".progcache";
+}
+
+uint64_t ProgramCache::hashProgram(const std::vector<std::string> &sources, const std::string &defines) {
+    uint64_t hash = 14695981039346656037ull;
+    for (auto &source: sources)
+        hash = hashString(hash, source.c_str());
+    hash = hashString(hash, defines.c_str());
+    const GLenum driverStrings[] = {GL_VENDOR, GL_RENDERER, GL_VERSION, GL_SHADING_LANGUAGE_VERSION};
+    for (GLenum name: driverStrings)
+        hash = hashString(hash, reinterpret_cast<const char *>(glGetString(name)));
+    return hash;
+}
+
+bool ProgramCache::load(GLuint program, const std::string &cachePath, uint64_t key) {
+    MappedFile file;
+    if (!file.open(cachePath) || file.size() < sizeof(Header))
+        return false;
+
+    Header header{};
+    memcpy(&header, file.data(), sizeof(header));
+    if (memcmp(header.magic, cacheMagic, sizeof(cacheMagic)) != 0 || header.version != version ||
+        header.key != key || header.binaryLength != file.size() - sizeof(Header))
+        return false;
+
+    // a driver update can still reject a binary whose key matched, the caller compiles then
+    glProgramBinary(program, header.binaryFormat, file.data() + sizeof(Header), (GLsizei) header.binaryLength);
+    GLint linked = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &linked);
+    return linked == GL_TRUE;
+}
+
+bool ProgramCache::store(GLuint program, const std::string &cachePath, uint64_t key) {
+    GLint formats = 0, linked = GL_FALSE, length = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    glGetProgramiv(program, GL_LINK_STATUS, &linked);
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (formats == 0 || linked != GL_TRUE || length <= 0)
+        return false;
+
+    std::vector<char> binary((size_t) length);
+    GLenum binaryFormat = 0;
+    GLsizei written = 0;
+    glGetProgramBinary(program, length, &written, &binaryFormat, binary.data());
+    if (written <= 0)
+        return false;
+
+    Header header{};
+    memcpy(header.magic, cacheMagic, sizeof(cacheMagic));
+    header.version = version;
+    header.key = key;
+    header.binaryFormat = binaryFormat;
+    header.binaryLength = (uint32_t) written;
+
+    // write to a temporary file first so a crash never leaves a truncated binary behind
+    std::string tempPath = cachePath + ".tmp";
+    std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+    if (!out)
+        return false;
+    out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    out.write(binary.data(), written);
+    out.close();
+    if (!out) {
+        std::remove(tempPath.c_str());
+        return false;
+    }
+
+    std::remove(cachePath.c_str());
+    if (std::rename(tempPath.c_str(), cachePath.c_str()) != 0) {
+        std::remove(tempPath.c_str());
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,31 @@
+#ifndef GRAPHICS_PROGRAMMING_PROGRAM_CACHE_H
+#define GRAPHICS_PROGRAMMING_PROGRAM_CACHE_H
+
+#include "GL/glew.h"
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+// Linked programs saved with glGetProgramBinary next to their shader sources.
+// Binaries are only valid for the driver that produced them, so the key covers the driver
+// strings as well as the GLSL, anything that does not match is compiled from source again.
+class ProgramCache
+{
+public:
+    static const uint32_t version = 1;
+
+    // one file per combination of stages and defines: shader/texture.vert+texture.frag.progcache,
+    // programs built with defines get a hash of them before the extension
+    static std::string cachePath(const std::vector<const char*>& stagePaths, const std::string& defines);
+
+    // source text of every stage, the defines they are built with and the current context's driver
+    static uint64_t hashProgram(const std::vector<std::string>& sources, const std::string& defines);
+
+    // links program from the binary, fails if it is missing, stale or rejected by the driver
+    static bool load(GLuint program, const std::string& cachePath, uint64_t key);
+
+    // program has to be linked with GL_PROGRAM_BINARY_RETRIEVABLE_HINT set
+    static bool store(GLuint program, const std::string& cachePath, uint64_t key);
+};
+#endif //GRAPHICS_PROGRAMMING_PROGRAM_CACHE_H
@@ -1,6 +1,31 @@
 #include "Shader.h"
+#include "StartupProfiler.h"
+#include "ProgramCache.h"
 
-Shader::Shader(const char *vertexPath, const char *fragmentPath, const char *geometryPath) {
+#include <vector>
+#include <algorithm>
+
+namespace {
+    // set by enableParallelCompile, otherwise the completion status is never queried
+    bool parallelCompile = false;
+
+    // after the #version line, which has to stay first, #line keeps the compiler's line numbers matching the file
+    void injectDefines(std::string &code, const std::string &defines) {
+        if (defines.empty())
+            return;
+        size_t version = code.find("#version");
+        size_t lineEnd = version == std::string::npos ? std::string::npos : code.find('\n', version);
+        if (lineEnd == std::string::npos) {
+            code.insert(0, defines + "#line 1\n");
+            return;
+        }
+        size_t line = (size_t) std::count(code.begin(), code.begin() + (std::ptrdiff_t) lineEnd, '\n') + 2;
+        code.insert(lineEnd + 1, defines + "#line " + std::to_string(line) + "\n");
+    }
+}
+
+Shader::Shader(const char *vertexPath, const char *fragmentPath, const char *geometryPath,
+               const std::string &defines) {
     std::cout << "vert " << vertexPath << ", frag " << fragmentPath << std::endl;
     // 1. retrieve the vertex/fragment source code from filePath
     std::string vertexCode;
@@ -42,43 +67,24 @@ Shader::Shader(const char *vertexPath, const char *fragmentPath, const char *geo
     {
         std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ" << std::endl;
     }
-    const char* vShaderCode = vertexCode.c_str();
-    const char* fShaderCode = fragmentCode.c_str();
-    // 2. compile shaders
-    unsigned int vertex, fragment, geometry;
-    // vertex shader
-    vertex = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vertex, 1, &vShaderCode, nullptr);
-    glCompileShader(vertex);
-    checkCompileErrors(vertex, "VERTEX");
-    // fragment shader
-    fragment = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragment, 1, &fShaderCode, nullptr);
-    glCompileShader(fragment);
-    checkCompileErrors(fragment, "FRAGMENT");
-    // if geometry shader is given, compile geometry shader
-    if(geometryPath != nullptr)
-    {
-        const char * gShaderCode = geometryCode.c_str();
-        geometry = glCreateShader(GL_GEOMETRY_SHADER);
-        glShaderSource(geometry, 1, &gShaderCode, nullptr);
-        glCompileShader(geometry);
-        checkCompileErrors(geometry, "GEOMETRY");
-    }
-    // shader materialShader
+    injectDefines(vertexCode, defines);
+    injectDefines(fragmentCode, defines);
+    injectDefines(geometryCode, defines);
+    // 2. reuse the driver's binary from an earlier run when nothing changed
+    cachePath = ProgramCache::cachePath({vertexPath, fragmentPath, geometryPath}, defines);
+    cacheKey = ProgramCache::hashProgram({vertexCode, fragmentCode, geometryCode}, defines);
     ID = glCreateProgram();
-    glAttachShader(ID, vertex);
-    glAttachShader(ID, fragment);
+    if (loadBinary())
+        return;
+    // 3. compile shaders, no status is queried before finish so the driver can work in the background
+    StartupProfiler::Scope profile("Shader compile");
+    compileStage(GL_VERTEX_SHADER, vertexCode, "VERTEX");
+    compileStage(GL_FRAGMENT_SHADER, fragmentCode, "FRAGMENT");
+    // if geometry shader is given, compile geometry shader
     if(geometryPath != nullptr)
-        glAttachShader(ID, geometry);
+        compileStage(GL_GEOMETRY_SHADER, geometryCode, "GEOMETRY");
+    glProgramParameteri(ID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
     glLinkProgram(ID);
-    checkCompileErrors(ID, "PROGRAM");
-    // delete the shaders as they're linked into our materialShader now and no longer necessary
-    glDeleteShader(vertex);
-    glDeleteShader(fragment);
-    if(geometryPath != nullptr)
-        glDeleteShader(geometry);
-
 }
 
 Shader::Shader(const char *computePath) {
@@ -102,21 +108,80 @@ Shader::Shader(const char *computePath) {
     catch (std::ifstream::failure& e) {
         std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ" << std::endl;
     }
-    const char* cShaderCode = computeCode.c_str();
-    // 2. compile shaders
-    unsigned int compute;
-    // compute shader
-    compute = glCreateShader(GL_COMPUTE_SHADER);
-    glShaderSource(compute, 1, &cShaderCode, nullptr);
-    glCompileShader(compute);
-    checkCompileErrors(compute, "COMPUTE");
-    // shader
+    // 2. reuse the driver's binary from an earlier run when nothing changed
+    cachePath = ProgramCache::cachePath({computePath}, "");
+    cacheKey = ProgramCache::hashProgram({computeCode}, "");
     ID = glCreateProgram();
-    glAttachShader(ID, compute);
+    if (loadBinary())
+        return;
+    // 3. compile shaders, no status is queried before finish so the driver can work in the background
+    StartupProfiler::Scope profile("Shader compile");
+    compileStage(GL_COMPUTE_SHADER, computeCode, "COMPUTE");
+    glProgramParameteri(ID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
     glLinkProgram(ID);
+}
+
+void Shader::compileStage(GLenum type, const std::string &code, const char *typeName) {
+    const char *source = code.c_str();
+    GLuint stage = glCreateShader(type);
+    glShaderSource(stage, 1, &source, nullptr);
+    glCompileShader(stage);
+    glAttachShader(ID, stage);
+    pendingStages.push_back(PendingStage{stage, typeName});
+}
+
+bool Shader::loadBinary() {
+    StartupProfiler::Scope profile("Shader cache read");
+    if (!ProgramCache::load(ID, cachePath, cacheKey))
+        return false;
+    reflectUniforms();
+    ready = true;
+    return true;
+}
+
+bool Shader::isReady() {
+    if (ready)
+        return true;
+    if (parallelCompile) {
+        GLint done = GL_FALSE;
+        glGetProgramiv(ID, GL_COMPLETION_STATUS_KHR, &done);
+        if (done != GL_TRUE)
+            return false;
+    }
+    finish();
+    return true;
+}
+
+void Shader::finish() {
+    if (ready)
+        return;
+    // the first status query blocks until the driver is done with the program
+    StartupProfiler::Scope profile("Shader compile");
+    for (auto &stage: pendingStages)
+        checkCompileErrors(stage.shader, stage.type);
     checkCompileErrors(ID, "PROGRAM");
+    ProgramCache::store(ID, cachePath, cacheKey);
+    reflectUniforms();
     // delete the shaders as they're linked into our materialShader now and no longer necessary
-    glDeleteShader(compute);
+    for (auto &stage: pendingStages)
+        glDeleteShader(stage.shader);
+    pendingStages.clear();
+    ready = true;
+    for (auto &binding: pendingBlockBindings)
+        setUniformBlockBinding(binding.first, binding.second);
+    pendingBlockBindings.clear();
+}
+
+bool Shader::enableParallelCompile() {
+    // 0xFFFFFFFF leaves the number of threads to the driver
+    if (GLEW_KHR_parallel_shader_compile)
+        glMaxShaderCompilerThreadsKHR(0xFFFFFFFFu);
+    else if (GLEW_ARB_parallel_shader_compile)
+        glMaxShaderCompilerThreadsARB(0xFFFFFFFFu);
+    else
+        return false;
+    parallelCompile = true;
+    return true;
 }
 
 void Shader::use() const {
@@ -124,60 +189,141 @@ void Shader::use() const {
 }
 
 void Shader::setBool(const std::string &name, bool value) const {
-    glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
+    uniform<bool>(name).set(value);
 }
 
 void Shader::setInt(const std::string &name, int value) const {
-    glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+    uniform<int>(name).set(value);
 }
 
 void Shader::setIntArray(const std::string& name, int* value, int count) const
 {
-    glUniform1iv(glGetUniformLocation(ID, name.c_str()), count, value);
+    UniformSlot *first = slot(name);
+    if (!first)
+        return;
+    // sent as is, the elements it covers lose their shadow copies
+    glProgramUniform1iv(ID, first->location, count, value);
+    uniformStats().issued++;
+    for (GLint element = 0; element < std::min((GLint) count, first->arraySize); element++)
+        first[element].known = false;
 }
 
 void Shader::setFloat(const std::string &name, float value) const {
-    glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+    uniform<float>(name).set(value);
 }
 
 void Shader::setVec2(const std::string &name, const glm::vec2 &value) const {
-    glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+    uniform<glm::vec2>(name).set(value);
 }
 
 void Shader::setVec2(const std::string &name, float x, float y) const {
-    glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y);
+    uniform<glm::vec2>(name).set(glm::vec2(x, y));
 }
 
 void Shader::setVec3(const std::string &name, const glm::vec3 &value) const {
-    glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+    uniform<glm::vec3>(name).set(value);
 }
 
 void Shader::setVec3(const std::string &name, float x, float y, float z) const {
-    glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z);
+    uniform<glm::vec3>(name).set(glm::vec3(x, y, z));
 }
 
 void Shader::setVec4(const std::string &name, const glm::vec4 &value) const {
-    glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+    uniform<glm::vec4>(name).set(value);
 }
 
 void Shader::setVec4(const std::string &name, float x, float y, float z, float w) const {
-    glUniform4f(glGetUniformLocation(ID, name.c_str()), x, y, z, w);
+    uniform<glm::vec4>(name).set(glm::vec4(x, y, z, w));
 }
 
 void Shader::setMat2(const std::string &name, const glm::mat2 &mat) const {
-    glUniformMatrix2fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, glm::value_ptr(mat));
+    uniform<glm::mat2>(name).set(mat);
 }
 
 void Shader::setMat3(const std::string &name, const glm::mat3 &mat) const {
-    glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, glm::value_ptr(mat));
+    uniform<glm::mat3>(name).set(mat);
 }
 
 void Shader::setMat4(const std::string &name, const glm::mat4 &mat) const {
-    glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, glm::value_ptr(mat));
+    uniform<glm::mat4>(name).set(mat);
+}
+
+GLint Shader::location(const std::string &name) const {
+    UniformSlot *found = slot(name);
+    return found ? found->location : -1;
+}
+
+UniformSlot *Shader::slot(const std::string &name) const {
+    auto found = slotIndices.find(name);
+    return found == slotIndices.end() ? nullptr : &slots[found->second];
+}
+
+bool Shader::update(UniformSlot *slot, const void *value, size_t size) {
+    if (!slot)
+        return false;
+    UniformStats &stats = uniformStats();
+    if (slot->known && memcmp(slot->value, value, size) == 0) {
+        stats.skipped++;
+        return false;
+    }
+    memcpy(slot->value, value, size);
+    slot->known = true;
+    stats.issued++;
+    return true;
+}
+
+UniformStats &Shader::uniformStats() {
+    static UniformStats stats;
+    return stats;
+}
+
+void Shader::reflectUniforms() {
+    slots.clear();
+    slotIndices.clear();
+    GLint count = 0, maxLength = 0;
+    glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+    glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+    std::vector<GLchar> buffer((size_t) std::max(maxLength, 1));
+    for (GLint i = 0; i < count; i++) {
+        GLsizei length = 0;
+        GLint size = 0;
+        GLenum type = 0;
+        glGetActiveUniform(ID, (GLuint) i, (GLsizei) buffer.size(), &length, &size, &type, buffer.data());
+        std::string name(buffer.data(), (size_t) length);
+        // members of uniform blocks have no location
+        GLint location = glGetUniformLocation(ID, name.c_str());
+        if (location < 0)
+            continue;
+        UniformSlot first;
+        first.program = ID;
+        first.location = location;
+        first.arraySize = size;
+        slotIndices[name] = slots.size();
+        slots.push_back(first);
+        // arrays are reported as name[0], callers also use the bare name and every other element,
+        // the other elements follow the first one in slots
+        if (name.size() > 3 && name.compare(name.size() - 3, 3, "[0]") == 0) {
+            std::string base = name.substr(0, name.size() - 3);
+            slotIndices[base] = slotIndices[name];
+            for (GLint element = 1; element < size; element++) {
+                std::string elementName = base + '[' + std::to_string(element) + ']';
+                UniformSlot next;
+                next.program = ID;
+                next.location = glGetUniformLocation(ID, elementName.c_str());
+                next.arraySize = size - element;
+                slotIndices[elementName] = slots.size();
+                slots.push_back(next);
+            }
+        }
+    }
 }
 
 void Shader::setUniformBlockBinding(const std::string& name, int value) const
 {
+    if (!ready) {
+        pendingBlockBindings.emplace_back(name, value);
+        return;
+    }
     glUniformBlockBinding(ID, glGetUniformBlockIndex(ID, name.c_str()), value);
 }
 
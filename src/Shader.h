@@ -5,17 +5,71 @@
 #include "GLM/glm.hpp"
 #include "GLM/gtc/type_ptr.hpp"
 #include <string>
+#include <unordered_map>
+#include <vector>
+#include <utility>
+#include <cstring>
+#include <cstdint>
 #include <fstream>
 #include <sstream>
 #include <iostream>
 
+// Last value sent to one uniform of one program, room for a mat4.
+// known stays false until the first write, GLSL initializers are never read back.
+struct UniformSlot
+{
+    GLuint program = 0;
+    GLint location = -1;
+    GLint arraySize = 1;    // elements that follow this one in Shader's slots, for array writes
+    bool known = false;
+    unsigned char value[sizeof(glm::mat4)];
+};
+
+// glProgramUniform calls made and skipped since the last reset
+struct UniformStats
+{
+    unsigned int issued = 0;
+    unsigned int skipped = 0;
+};
+
+// A uniform resolved once, set() makes no lookup and no allocation and skips values the program already has.
+// Writes go to the handle's program whichever one is in use.
+template<class T>
+class UniformHandle
+{
+public:
+    UniformHandle() = default;
+    explicit UniformHandle(UniformSlot* slot) : slot(slot) {}
+
+    void set(const T& value) const;
+    // an inactive uniform was optimized out or misspelled, set does nothing then
+    bool isActive() const { return slot != nullptr; }
+
+private:
+    UniformSlot* slot = nullptr;
+};
+
 class Shader
 {
 public:
     // constructor generates the shader on the fly
     // ------------------------------------------------------------------------
-    Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr);
+    // defines are complete #define lines, injected into every stage after its #version
+    Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr,
+           const std::string& defines = std::string());
     explicit Shader(const char* computePath);
+    // handles point into the shader
+    Shader(const Shader&) = delete;
+    Shader& operator=(const Shader&) = delete;
+    // Compile and link run in the background where the driver supports it. isReady polls without blocking
+    // and finishes the program once the driver is done, finish waits for it. Uniforms resolve and set
+    // only on a ready program.
+    // ------------------------------------------------------------------------
+    bool isReady();
+    void finish();
+    // lets the driver compile on its own threads, call once before the first program is created.
+    // false without KHR/ARB_parallel_shader_compile, programs then finish on their first isReady
+    static bool enableParallelCompile();
     // activate the shader
     // ------------------------------------------------------------------------
     void use() const;
@@ -43,13 +97,83 @@ public:
     void setMat3(const std::string &name, const glm::mat3 &mat) const;
     // ------------------------------------------------------------------------
     void setMat4(const std::string &name, const glm::mat4 &mat) const;
+    // before the program is ready the binding is remembered and made by finish
     // ------------------------------------------------------------------------
     void setUniformBlockBinding(const std::string& name, int value) const;
+    // location from the table built at link, -1 for names that are not active
+    // ------------------------------------------------------------------------
+    GLint location(const std::string &name) const;
+    template<class T>
+    UniformHandle<T> uniform(const std::string &name) const { return UniformHandle<T>(slot(name)); }
+
+    // Compares value against the slot's shadow copy, true when it differs and has to be sent.
+    // Counts into uniformStats, a null slot is neither.
+    static bool update(UniformSlot *slot, const void *value, size_t size);
+    // shared by every program, the owner resets it once per frame
+    static UniformStats &uniformStats();
 
 private:
+    struct PendingStage {
+        GLuint shader;
+        const char* type;
+    };
+
     unsigned int ID;
+    bool ready = false;
+    // compiling until finish checks and deletes them
+    std::vector<PendingStage> pendingStages;
+    mutable std::vector<std::pair<std::string, int>> pendingBlockBindings;
+    std::string cachePath;
+    uint64_t cacheKey = 0;
+    // one per active uniform and array element, fixed after link so handles can point into it
+    mutable std::vector<UniformSlot> slots;
+    // array elements by index as well as by their bare name
+    std::unordered_map<std::string, size_t> slotIndices;
+    void reflectUniforms();
+    // links from the program binary cache, false when the sources have to be compiled
+    bool loadBinary();
+    void compileStage(GLenum type, const std::string &code, const char* typeName);
+    UniformSlot *slot(const std::string &name) const;
     // utility function for checking shader compilation/linking errors.
     // ------------------------------------------------------------------------
     static void checkCompileErrors(GLuint shader, const std::string& type);
 };
+
+template<> inline void UniformHandle<bool>::set(const bool &value) const {
+    int integer = value;
+    if (Shader::update(slot, &integer, sizeof(integer)))
+        glProgramUniform1i(slot->program, slot->location, integer);
+}
+template<> inline void UniformHandle<int>::set(const int &value) const {
+    if (Shader::update(slot, &value, sizeof(value)))
+        glProgramUniform1i(slot->program, slot->location, value);
+}
+template<> inline void UniformHandle<float>::set(const float &value) const {
+    if (Shader::update(slot, &value, sizeof(value)))
+        glProgramUniform1f(slot->program, slot->location, value);
+}
+template<> inline void UniformHandle<glm::vec2>::set(const glm::vec2 &value) const {
+    if (Shader::update(slot, &value, sizeof(value)))
+        glProgramUniform2fv(slot->program, slot->location, 1, &value[0]);
+}
+template<> inline void UniformHandle<glm::vec3>::set(const glm::vec3 &value) const {
+    if (Shader::update(slot, &value, sizeof(value)))
+        glProgramUniform3fv(slot->program, slot->location, 1, &value[0]);
+}
+template<> inline void UniformHandle<glm::vec4>::set(const glm::vec4 &value) const {
+    if (Shader::update(slot, &value, sizeof(value)))
+        glProgramUniform4fv(slot->program, slot->location, 1, &value[0]);
+}
+template<> inline void UniformHandle<glm::mat2>::set(const glm::mat2 &value) const {
+    if (Shader::update(slot, &value, sizeof(value)))
+        glProgramUniformMatrix2fv(slot->program, slot->location, 1, GL_FALSE, glm::value_ptr(value));
+}
+template<> inline void UniformHandle<glm::mat3>::set(const glm::mat3 &value) const {
+    if (Shader::update(slot, &value, sizeof(value)))
+        glProgramUniformMatrix3fv(slot->program, slot->location, 1, GL_FALSE, glm::value_ptr(value));
+}
+template<> inline void UniformHandle<glm::mat4>::set(const glm::mat4 &value) const {
+    if (Shader::update(slot, &value, sizeof(value)))
+        glProgramUniformMatrix4fv(slot->program, slot->location, 1, GL_FALSE, glm::value_ptr(value));
+}
 #endif //GRAPHICS_PROGRAMMING_SHADER_H
@@ -0,0 +1,30 @@
+#include "ShaderVariants.h"
+
+#include <utility>
+
+ShaderVariants::ShaderVariants(std::string vertexPath, std::string fragmentPath, std::vector<std::string> features)
+        : vertexPath(std::move(vertexPath)), fragmentPath(std::move(fragmentPath)), features(std::move(features)) {}
+
+Shader *ShaderVariants::get(uint32_t mask) {
+    auto found = variants.find(mask);
+    if (found != variants.end())
+        return found->second.get();
+    std::cout << "Shader variant " << mask << ":" << (mask ? "" : " none");
+    for (size_t i = 0; i < features.size(); i++) {
+        if (mask & (1u << i))
+            std::cout << ' ' << features[i];
+    }
+    std::cout << std::endl;
+    Shader *variant = new Shader(vertexPath.c_str(), fragmentPath.c_str(), nullptr, defines(mask));
+    variants[mask].reset(variant);
+    return variant;
+}
+
+std::string ShaderVariants::defines(uint32_t mask) const {
+    std::string lines;
+    for (size_t i = 0; i < features.size(); i++) {
+        if (mask & (1u << i))
+            lines += "#define " + features[i] + '\n';
+    }
+    return lines;
+}
@@ -0,0 +1,33 @@
+#ifndef GRAPHICS_PROGRAMMING_SHADER_VARIANTS_H
+#define GRAPHICS_PROGRAMMING_SHADER_VARIANTS_H
+
+#include "Shader.h"
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <unordered_map>
+
+// Permutations of one program, feature i is compiled in as #define features[i] when bit i of the mask is set.
+// Variants are compiled the first time they are asked for and kept for the lifetime of the object.
+class ShaderVariants
+{
+public:
+    ShaderVariants(std::string vertexPath, std::string fragmentPath, std::vector<std::string> features);
+
+    // a new variant starts compiling in the background, poll it with Shader::isReady
+    Shader* get(uint32_t mask);
+
+    // #define lines for the features in mask
+    std::string defines(uint32_t mask) const;
+
+    size_t size() const { return variants.size(); }
+
+private:
+    std::string vertexPath;
+    std::string fragmentPath;
+    std::vector<std::string> features;
+    std::unordered_map<uint32_t, std::unique_ptr<Shader>> variants;
+};
+#endif //GRAPHICS_PROGRAMMING_SHADER_VARIANTS_H
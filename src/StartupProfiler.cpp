@@ -0,0 +1,133 @@
+#include "StartupProfiler.h"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+namespace {
+    double milliseconds(StartupProfiler::Clock::duration duration) {
+        return std::chrono::duration<double, std::milli>(duration).count();
+    }
+
+    // phase names are plain identifiers in practice, quotes and backslashes are escaped all the same
+    std::string jsonString(const std::string &text) {
+        std::string quoted = "\"";
+        for (char c: text) {
+            if (c == '"' || c == '\\')
+                quoted += '\\';
+            quoted += c;
+        }
+        return quoted + '"';
+    }
+}
+
+StartupProfiler::Scope::Scope(const char *phase) : phase(phase), start(Clock::now()) {
+}
+
+StartupProfiler::Scope::~Scope() {
+    stop();
+}
+
+void StartupProfiler::Scope::stop() {
+    if (!running)
+        return;
+    running = false;
+    StartupProfiler::shared().add(phase, milliseconds(Clock::now() - start));
+}
+
+StartupProfiler &StartupProfiler::shared() {
+    static StartupProfiler profiler;
+    return profiler;
+}
+
+void StartupProfiler::add(const char *phase, double elapsedMilliseconds) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto found = std::find_if(phases.begin(), phases.end(), [phase](const Phase &p) { return p.name == phase; });
+    if (found == phases.end()) {
+        phases.push_back(Phase{phase, 0.0, 0.0, 0});
+        found = phases.end() - 1;
+    }
+    found->milliseconds += elapsedMilliseconds;
+    found->longest = std::max(found->longest, elapsedMilliseconds);
+    found->count++;
+}
+
+double StartupProfiler::elapsed() const {
+    return milliseconds(Clock::now() - start);
+}
+
+void StartupProfiler::markFirstFrame() {
+    if (firstFrame == 0.0)
+        firstFrame = elapsed();
+}
+
+void StartupProfiler::report(const std::string &path) {
+    if (reported)
+        return;
+    reported = true;
+    double loaded = elapsed();
+    size_t peak = peakResidentBytes();
+    std::vector<Phase> snapshot;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        snapshot = phases;
+    }
+
+    std::ostringstream table;
+    table << std::fixed << std::setprecision(1);
+    table << "Startup profile\n";
+    table << "  " << std::left << std::setw(24) << "phase" << std::right << std::setw(10) << "total ms"
+          << std::setw(10) << "max ms" << std::setw(8) << "count" << "\n";
+    for (auto &phase: snapshot) {
+        table << "  " << std::left << std::setw(24) << phase.name << std::right << std::setw(10)
+              << phase.milliseconds << std::setw(10) << phase.longest << std::setw(8) << phase.count << "\n";
+    }
+    table << "  first frame " << firstFrame << " ms, fully loaded " << loaded << " ms, peak RSS "
+          << peak / (1024 * 1024) << " MB\n";
+    std::cout << table.str() << std::flush;
+
+    std::ofstream out(path, std::ios::trunc);
+    if (!out) {
+        std::cout << "Failed to write startup profile: " << path << std::endl;
+        return;
+    }
+    out << std::fixed << std::setprecision(3);
+    out << "{\n  \"firstFrameMs\": " << firstFrame << ",\n  \"loadedMs\": " << loaded
+        << ",\n  \"peakResidentBytes\": " << peak << ",\n  \"phases\": [";
+    for (size_t i = 0; i < snapshot.size(); i++) {
+        out << (i ? ",\n" : "\n") << "    {\"name\": " << jsonString(snapshot[i].name) << ", \"totalMs\": "
+            << snapshot[i].milliseconds << ", \"maxMs\": " << snapshot[i].longest << ", \"count\": "
+            << snapshot[i].count << "}";
+    }
+    out << "\n  ]\n}\n";
+}
+
+size_t StartupProfiler::peakResidentBytes() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return 0;
+    return counters.PeakWorkingSetSize;
+#else
+    rusage usage{};
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0;
+#ifdef __APPLE__
+    return (size_t) usage.ru_maxrss;
+#else
+    // kilobytes on Linux
+    return (size_t) usage.ru_maxrss * 1024;
+#endif
+#endif
+}
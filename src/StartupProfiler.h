@@ -0,0 +1,65 @@
+#ifndef GRAPHICS_PROGRAMMING_STARTUP_PROFILER_H
+#define GRAPHICS_PROGRAMMING_STARTUP_PROFILER_H
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <chrono>
+#include <cstddef>
+
+// Wall time per loading phase from the start of main until the scene is fully loaded.
+// Scopes may close on any thread, a phase's total is the sum over every thread, so phases
+// that overlap on the ThreadPool can add up to more than the elapsed time.
+class StartupProfiler
+{
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    // times its own lifetime, or until stop
+    class Scope
+    {
+    public:
+        explicit Scope(const char* phase);
+        ~Scope();
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+        void stop();
+
+    private:
+        const char* phase;
+        Clock::time_point start;
+        bool running = true;
+    };
+
+    static StartupProfiler& shared();
+
+    void add(const char* phase, double milliseconds);
+    // milliseconds since shared() was first called
+    double elapsed() const;
+    // remembers the time of the first presented frame, later calls do nothing
+    void markFirstFrame();
+    // once: prints the table and writes it as JSON to path, later calls do nothing
+    void report(const std::string& path);
+    bool hasReported() const { return reported; }
+
+    // high water mark of the resident set, 0 where the platform cannot tell
+    static size_t peakResidentBytes();
+
+private:
+    struct Phase {
+        std::string name;
+        double milliseconds;
+        double longest;
+        unsigned int count;
+    };
+
+    Clock::time_point start = Clock::now();
+    double firstFrame = 0.0;
+    bool reported = false;
+    std::mutex mutex;
+    std::vector<Phase> phases;     // in order of first use
+
+    StartupProfiler() = default;
+};
+#endif //GRAPHICS_PROGRAMMING_STARTUP_PROFILER_H
@@ -1,65 +1,166 @@
 #include "Texture.h"
+#include "TextureContainer.h"
+#include "MappedFile.h"
 #include "stb_image.h"
 
 Texture::TextureData::TextureData() : width(0), height(0), data(nullptr) {}
 
-Texture::TextureData Texture::loadImg(const std::string &imgFilePath) {
-    TextureData textureData;
+bool Texture::imageSize(const unsigned char *encoded, size_t size, int &width, int &height) {
     int components;
+    return stbi_info_from_memory(encoded, (int) size, &width, &height, &components) != 0;
+}
 
-    // load the textureData with stb image, force RGBA (4 components required)
-    stbi_uc *data = stbi_load(imgFilePath.c_str(), &textureData.width, &textureData.height, &components, 4);
-
-    // is the image successfully loaded?
-    if(data != nullptr)
-    {
-        // copy the raw data
-        size_t dataSize = textureData.width * textureData.height * 4 * sizeof(unsigned char);
-        textureData.data = new unsigned char[dataSize];
-        memcpy(textureData.data, data, dataSize);
-
-        // mirror the image vertically to comply with OpenGL convention
-        for (size_t i = 0; i < textureData.width; ++i)
-        {
-            for (size_t j = 0; j < textureData.height / 2; ++j)
-            {
-                for(size_t k = 0; k < 4; ++k)
-                {
-                    size_t coord1 = (j * textureData.width + i) * 4 + k;
-                    size_t coord2 = ((textureData.height - j - 1) * textureData.width + i) * 4 + k;
-                    std::swap(textureData.data[coord1], textureData.data[coord2]);
-                }
-            }
-        }
+bool Texture::decodeFlipped(const unsigned char *encoded, size_t size, int width, int height,
+                            unsigned char *destination, bool *opaque) {
+    int decodedWidth, decodedHeight, components;
+    stbi_uc *pixels = stbi_load_from_memory(encoded, (int) size, &decodedWidth, &decodedHeight, &components, 4);
+    if (!pixels)
+        return false;
+    if (decodedWidth != width || decodedHeight != height) {
+        stbi_image_free(pixels);
+        return false;
+    }
+
+    // mirror the image vertically to comply with OpenGL convention, a whole row per memcpy
+    size_t rowSize = (size_t) width * 4;
+    for (int row = 0; row < height; row++)
+        memcpy(destination + (size_t) (height - row - 1) * rowSize, pixels + (size_t) row * rowSize, rowSize);
 
-        // release the loaded image
-        stbi_image_free(data);
+    // read back from the decoded pixels, the destination may be write combined memory
+    if (opaque) {
+        *opaque = true;
+        for (size_t i = 3; i < rowSize * height && *opaque; i += 4)
+            *opaque = pixels[i] == 255;
     }
+    stbi_image_free(pixels);
+    return true;
+}
 
+Texture::TextureData Texture::loadImg(const std::string &imgFilePath) {
+    TextureData textureData;
+    MappedFile file(imgFilePath);
+    if (!file.isOpen() || !imageSize(file.data(), file.size(), textureData.width, textureData.height))
+        return textureData;
+
+    textureData.data = new unsigned char[(size_t) textureData.width * textureData.height * 4];
+    if (!decodeFlipped(file.data(), file.size(), textureData.width, textureData.height, textureData.data)) {
+        delete[] textureData.data;
+        textureData = TextureData();
+    }
     return textureData;
 }
 
-Texture::Texture(const std::string &filename) {
-    TextureData textureData = loadImg(filename);
+GLenum Texture::internalFormat(Usage usage, bool opaque) {
+    switch (usage) {
+        case Usage::Albedo:
+            return opaque ? GL_SRGB8 : GL_SRGB8_ALPHA8;
+        case Usage::NormalMap:
+            return GL_RG8;
+        case Usage::Mask:
+            return GL_R8;
+        case Usage::Data:
+            return opaque ? GL_RGB8 : GL_RGBA8;
+    }
+    return GL_RGBA8;
+}
+
+size_t Texture::texelSize(GLenum internalFormat) {
+    switch (internalFormat) {
+        case GL_R8:
+            return 1;
+        case GL_RG8:
+            return 2;
+        default:
+            return 4;
+    }
+}
 
-    glGenTextures(1, &texture);
-    glBindTexture(GL_TEXTURE_2D, texture);
+Texture::Texture(const std::string &filename, Usage usage) {
+    const TextureCache::Format formats[] = {TextureCache::Format::Image, TextureCache::Format::ImageNormalMap,
+                                            TextureCache::Format::ImageMask, TextureCache::Format::ImageData};
+    bool isNew;
+    handle = TextureCache::shared().acquire(filename, formats[static_cast<int>(usage)], isNew);
+    texture = handle.id();
+    if (!isNew)
+        return;
+
+    if (TextureContainer::recognizes(filename)) {
+        loadContainer(filename);
+        return;
+    }
+
+    MappedFile file(filename);
+    int width, height;
+    if (!file.isOpen() || !imageSize(file.data(), file.size(), width, height)) {
+        std::cout << "Failed to load texture \"" << filename << "\"" << std::endl;
+        return;
+    }
+
+    // the pixels are decoded and flipped straight into a mapped unpack buffer, the driver copies from there
+    size_t size = (size_t) width * height * 4;
+    GLuint unpackBuffer;
+    glGenBuffers(1, &unpackBuffer);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, unpackBuffer);
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, (GLsizeiptr) size, nullptr, GL_STREAM_DRAW);
+    auto *pixels = static_cast<unsigned char *>(glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, (GLsizeiptr) size,
+                                                                 GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT));
+    bool opaque = true;
+    bool decoded = pixels && decodeFlipped(file.data(), file.size(), width, height, pixels, &opaque);
+    if (pixels)
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
 
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, textureData.width, textureData.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, textureData.data);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    GLenum format = internalFormat(usage, opaque);
+    if (decoded) {
+        // the driver drops the channels the format does not keep
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        if (usage == Usage::Mask) {
+            const GLint swizzle[4] = {GL_RED, GL_RED, GL_RED, GL_ONE};
+            glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+        }
+        TextureCache::shared().setResidentBytes(texture, (size_t) width * height * texelSize(format));
+    }
 //        glGenerateMipmap(GL_TEXTURE_2D);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    glDeleteBuffers(1, &unpackBuffer);
 
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
-    std::cout << "Loaded texture \"" << filename << "\"" << std::endl;
-
-    delete textureData.data;
+    if (decoded)
+        std::cout << "Loaded texture \"" << filename << "\" (" << (size_t) width * height * texelSize(format) / 1024
+                  << " KB)" << std::endl;
+    else
+        std::cout << "Failed to load texture \"" << filename << "\"" << std::endl;
 }
 
-Texture::~Texture() {
-    glDeleteTextures(1, &texture);
+void Texture::loadContainer(const std::string &filename) const {
+    TextureContainer container;
+    if (!container.open(filename)) {
+        std::cout << "Failed to load texture \"" << filename << "\"" << std::endl;
+        return;
+    }
+    if (container.layerCount > 1)
+        std::cout << "Texture \"" << filename << "\" has " << container.layerCount << " layers, using the first"
+                  << std::endl;
+
+    // uploaded as stored, containers are expected to be authored bottom row first
+    glBindTexture(GL_TEXTURE_2D, texture);
+    container.upload(GL_TEXTURE_2D);
+    size_t size = 0;
+    for (int level = 0; level < container.levelCount; level++)
+        size += container.image(level, 0).size;
+    TextureCache::shared().setResidentBytes(texture, size);
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, container.levelCount > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    std::cout << "Loaded texture \"" << filename << "\" (" << size / 1024 << " KB)" << std::endl;
 }
 
 void Texture::bind(unsigned int slot) const {
@@ -4,6 +4,7 @@
 #include "GL/glew.h"
 #include "glm/glm.hpp"
 #include "glm/gtc/type_ptr.hpp"
+#include "TextureCache.h"
 #include <string>
 #include <iostream>
 
@@ -18,15 +19,39 @@ private:
         unsigned char* data;
     };
 
+    // shared with every other Texture of the same file
+    TextureCache::Handle handle;
+
+    // DDS and KTX2, every level goes up as stored
+    void loadContainer(const std::string& filename) const;
+
 public:
+    // picks the internal format, 8 bit sources never take more than 4 bytes per texel
+    enum class Usage {
+        Albedo,     // GL_SRGB8_ALPHA8, GL_SRGB8 when opaque
+        NormalMap,  // GL_RG8, z is rebuilt from the unit length
+        Mask,       // GL_R8, sampled as (r, r, r, 1)
+        Data        // GL_RGBA8, GL_RGB8 when opaque
+    };
+
     GLuint texture = 0;
 
     // load a png image and return a TextureData structure with raw data
     // not limited to png format. works with any image format that is RGBA-32bit
     static TextureData loadImg(const std::string& imgFilePath);
 
-    explicit Texture(const std::string& filename);
-    ~Texture();
+    // dimensions of an encoded image in memory, without decoding it
+    static bool imageSize(const unsigned char* encoded, size_t size, int& width, int& height);
+    // decodes to RGBA8 bottom row first, destination holds width * height * 4 bytes as given by imageSize
+    // opaque, if given, tells whether every alpha is 255
+    static bool decodeFlipped(const unsigned char* encoded, size_t size, int width, int height,
+                              unsigned char* destination, bool* opaque = nullptr);
+
+    static GLenum internalFormat(Usage usage, bool opaque);
+    // resident size of one texel, RGB8 counts 4 since drivers pad it
+    static size_t texelSize(GLenum internalFormat);
+
+    explicit Texture(const std::string& filename, Usage usage = Usage::Albedo);
 
     void bind(unsigned int slot) const;
 
@@ -0,0 +1,228 @@
+#include "TextureBake.h"
+#include "BlockCompressor.h"
+#include "MipGenerator.h"
+#include "ModelCache.h"
+
+#include <cstring>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+
+#include "stb_image.h"
+
+namespace {
+    const char bakeMagic[4] = {'G', 'P', 'T', 'X'};
+    const uint64_t levelAlignment = 16;
+
+    struct Header {
+        char magic[4];
+        uint32_t version;
+        uint64_t sourceHash;
+        uint32_t usage;
+        uint32_t internalFormat;
+        uint32_t levelCount;
+        uint32_t reserved;
+        uint64_t fileSize;
+    };
+
+    struct LevelRecord {
+        uint32_t width;
+        uint32_t height;
+        uint64_t offset;
+        uint64_t size;
+    };
+
+    uint64_t align(uint64_t offset) {
+        return (offset + levelAlignment - 1) & ~(levelAlignment - 1);
+    }
+
+    bool inRange(uint64_t offset, uint64_t size, uint64_t fileSize) {
+        return offset <= fileSize && size <= fileSize - offset;
+    }
+
+    size_t compressedLevelSize(GLenum internalFormat, uint32_t width, uint32_t height) {
+        size_t blockSize = internalFormat == GL_COMPRESSED_RGB_S3TC_DXT1_EXT ? 8 : 16;
+        return (size_t) ((width + 3) / 4) * ((height + 3) / 4) * blockSize;
+    }
+
+    // alpha that only switches texels on and off survives the BC3 alpha block, anything softer goes to BC7
+    BlockCompressor::Format diffuseFormat(const std::vector<unsigned char> &rgba) {
+        bool opaque = true, cutout = true;
+        for (size_t i = 3; i < rgba.size(); i += 4) {
+            opaque = opaque && rgba[i] == 255;
+            cutout = cutout && (rgba[i] <= 8 || rgba[i] >= 247);
+        }
+        if (opaque)
+            return BlockCompressor::Format::BC1;
+        return cutout ? BlockCompressor::Format::BC3 : BlockCompressor::Format::BC7;
+    }
+
+    GLenum glFormat(BlockCompressor::Format format) {
+        switch (format) {
+            case BlockCompressor::Format::BC1:
+                return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+            case BlockCompressor::Format::BC3:
+                return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+            case BlockCompressor::Format::BC5:
+                return GL_COMPRESSED_RG_RGTC2;
+            case BlockCompressor::Format::BC7:
+                return GL_COMPRESSED_RGBA_BPTC_UNORM;
+        }
+        return 0;
+    }
+}
+
+bool TextureBake::load(const std::string &imagePath, Usage usage) {
+    if (TextureContainer::recognizes(imagePath)) {
+        levels.clear();
+        if (!container.open(imagePath))
+            return false;
+        internalFormat = container.internalFormat;
+        for (int level = 0; level < container.levelCount; level++) {
+            const TextureContainer::Image &image = container.image(level, 0);
+            levels.push_back(Level{image.width, image.height, image.data, image.size});
+        }
+        return true;
+    }
+
+    // one file per usage, an image used both ways would otherwise rebake on every load
+    std::string bakePath = imagePath + (usage == Usage::NormalMap ? ".normal" : ".diffuse") + ".texcache";
+    uint64_t sourceHash = ModelCache::hashSource(imagePath);
+    if (open(bakePath, sourceHash, usage))
+        return true;
+    if (!bake(imagePath, usage))
+        return false;
+    if (!write(bakePath, sourceHash, usage))
+        std::cout << "Failed to write texture cache: " << bakePath << std::endl;
+    return true;
+}
+
+size_t TextureBake::size() const {
+    size_t total = 0;
+    for (auto &level: levels)
+        total += level.size;
+    return total;
+}
+
+bool TextureBake::bake(const std::string &imagePath, Usage usage) {
+    int width, height, components;
+    unsigned char *pixels = stbi_load(imagePath.c_str(), &width, &height, &components, 4);
+    if (!pixels)
+        return false;
+    std::vector<unsigned char> rgba(pixels, pixels + (size_t) width * height * 4);
+    stbi_image_free(pixels);
+
+    BlockCompressor::Format format = usage == Usage::NormalMap ? BlockCompressor::Format::BC5 : diffuseFormat(rgba);
+    internalFormat = glFormat(format);
+
+    // the chain goes down to 1x1 like glGenerateMipmap, but filtered in linear light and, for cut outs, with the
+    // alpha coverage the shaders' 0.5 alpha test sees kept the same on every level
+    std::vector<MipGenerator::Level> mips = MipGenerator::generate(
+            rgba.data(), width, height,
+            usage == Usage::NormalMap ? MipGenerator::Content::NormalMap : MipGenerator::Content::Color,
+            format == BlockCompressor::Format::BC1 ? 0.0f : 0.5f);
+    std::vector<size_t> offsets;
+    storage.clear();
+    for (auto &mip: mips) {
+        std::vector<unsigned char> compressed = BlockCompressor::compress(mip.rgba.data(), mip.width, mip.height,
+                                                                          format);
+        offsets.push_back(storage.size());
+        storage.insert(storage.end(), compressed.begin(), compressed.end());
+    }
+
+    levels.clear();
+    for (size_t i = 0; i < offsets.size(); i++) {
+        size_t end = i + 1 < offsets.size() ? offsets[i + 1] : storage.size();
+        levels.push_back(Level{mips[i].width, mips[i].height, storage.data() + offsets[i], end - offsets[i]});
+    }
+    std::cout << "Texture baked: " << imagePath << " " << levels[0].width << "x" << levels[0].height << ", "
+              << levels.size() << " levels, " << size() / 1024 << " KB\n" << std::flush;
+    return true;
+}
+
+bool TextureBake::write(const std::string &bakePath, uint64_t sourceHash, Usage usage) const {
+    std::vector<LevelRecord> records(levels.size());
+    uint64_t offset = sizeof(Header) + sizeof(LevelRecord) * records.size();
+    for (size_t i = 0; i < levels.size(); i++) {
+        offset = align(offset);
+        records[i] = LevelRecord{(uint32_t) levels[i].width, (uint32_t) levels[i].height, offset, levels[i].size};
+        offset += levels[i].size;
+    }
+
+    Header header{};
+    memcpy(header.magic, bakeMagic, sizeof(bakeMagic));
+    header.version = version;
+    header.sourceHash = sourceHash;
+    header.usage = (uint32_t) usage;
+    header.internalFormat = internalFormat;
+    header.levelCount = (uint32_t) records.size();
+    header.fileSize = offset;
+
+    // a crash never leaves a truncated bake behind
+    std::string tempPath = bakePath + ".tmp";
+    std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+    if (!out)
+        return false;
+
+    uint64_t written = 0;
+    auto put = [&](const void *data, uint64_t size) {
+        out.write(static_cast<const char *>(data), (std::streamsize) size);
+        written += size;
+    };
+    put(&header, sizeof(header));
+    put(records.data(), sizeof(LevelRecord) * records.size());
+    for (auto &level: levels) {
+        static const char zeros[levelAlignment] = {};
+        put(zeros, align(written) - written);
+        put(level.data, level.size);
+    }
+    out.close();
+    if (!out || written != header.fileSize) {
+        std::remove(tempPath.c_str());
+        return false;
+    }
+
+    std::remove(bakePath.c_str());
+    if (std::rename(tempPath.c_str(), bakePath.c_str()) != 0) {
+        std::remove(tempPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool TextureBake::open(const std::string &bakePath, uint64_t sourceHash, Usage usage) {
+    levels.clear();
+    if (!file.open(bakePath))
+        return false;
+
+    const unsigned char *base = file.data();
+    uint64_t fileSize = file.size();
+    if (fileSize < sizeof(Header)) {
+        file.close();
+        return false;
+    }
+
+    Header header{};
+    memcpy(&header, base, sizeof(header));
+    if (memcmp(header.magic, bakeMagic, sizeof(bakeMagic)) != 0 || header.version != version ||
+        header.sourceHash != sourceHash || header.usage != (uint32_t) usage || header.fileSize != fileSize ||
+        header.levelCount == 0 || !inRange(sizeof(Header), sizeof(LevelRecord) * (uint64_t) header.levelCount, fileSize)) {
+        // a stale bake stays unmapped so write can replace it
+        file.close();
+        return false;
+    }
+
+    const auto *records = reinterpret_cast<const LevelRecord *>(base + sizeof(Header));
+    for (uint32_t i = 0; i < header.levelCount; i++) {
+        const LevelRecord &record = records[i];
+        if (record.width == 0 || record.height == 0 || !inRange(record.offset, record.size, fileSize) ||
+            record.size != compressedLevelSize(header.internalFormat, record.width, record.height)) {
+            levels.clear();
+            file.close();
+            return false;
+        }
+        levels.push_back(Level{(int) record.width, (int) record.height, base + record.offset, (size_t) record.size});
+    }
+    internalFormat = header.internalFormat;
+    return true;
+}
@@ -0,0 +1,59 @@
+#ifndef GRAPHICS_PROGRAMMING_TEXTURE_BAKE_H
+#define GRAPHICS_PROGRAMMING_TEXTURE_BAKE_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+#include "GL/glew.h"
+#include "MappedFile.h"
+#include "TextureContainer.h"
+
+// GPU ready form of a model texture: a block compressed mip chain.
+// Baked from the source image on first use, written next to it as <image>.<usage>.texcache and memory mapped
+// on later runs, so loading a texture is a straight glCompressedTexImage2D of every level.
+// DDS and KTX2 images are already GPU ready and are served straight from their own mapping instead.
+// Everything here is CPU only and meant to run on a ThreadPool worker.
+class TextureBake
+{
+public:
+    static const uint32_t version = 2;
+
+    enum class Usage {
+        Diffuse,    // BC1 when opaque, BC3 when alpha is a cut out mask, BC7 for any other alpha
+        NormalMap   // BC5 from x and y, the shaders rebuild z
+    };
+
+    struct Level {
+        int width;
+        int height;
+        const unsigned char* data;
+        size_t size;
+    };
+
+    GLenum internalFormat = 0;
+    std::vector<Level> levels;
+
+    TextureBake() = default;
+    TextureBake(const TextureBake&) = delete;
+    TextureBake& operator=(const TextureBake&) = delete;
+
+    // uses the bake when it was made from the same image for the same usage, otherwise decodes, bakes and
+    // writes it, fails only if the image cannot be read. Containers are never baked, only their first layer is used
+    bool load(const std::string& imagePath, Usage usage);
+
+    // every level, in bytes
+    size_t size() const;
+
+private:
+    MappedFile file;
+    TextureContainer container;
+    // a fresh bake is served from memory
+    std::vector<unsigned char> storage;
+
+    bool open(const std::string& bakePath, uint64_t sourceHash, Usage usage);
+    bool bake(const std::string& imagePath, Usage usage);
+    bool write(const std::string& bakePath, uint64_t sourceHash, Usage usage) const;
+};
+#endif //GRAPHICS_PROGRAMMING_TEXTURE_BAKE_H
@@ -0,0 +1,156 @@
+#include "TextureCache.h"
+
+#include <vector>
+#include <cctype>
+#include <cstdlib>
+#include <climits>
+#include <algorithm>
+
+namespace {
+    const char *formatNames[] = {"diffuse", "normal", "image", "image normal", "image mask", "image data"};
+
+    // collapse '.', '..' and repeated separators when the file cannot be resolved
+    std::string normalizePath(const std::string &path) {
+        std::vector<std::string> parts;
+        bool absolute = !path.empty() && path[0] == '/';
+        size_t start = 0;
+        while (start <= path.size()) {
+            size_t end = path.find('/', start);
+            if (end == std::string::npos)
+                end = path.size();
+            std::string part = path.substr(start, end - start);
+            if (part == "..") {
+                if (!parts.empty() && parts.back() != "..")
+                    parts.pop_back();
+                else if (!absolute)
+                    parts.push_back(part);
+            } else if (!part.empty() && part != ".") {
+                parts.push_back(part);
+            }
+            start = end + 1;
+        }
+        std::string result = absolute ? "/" : "";
+        for (size_t i = 0; i < parts.size(); i++) {
+            if (i > 0)
+                result += '/';
+            result += parts[i];
+        }
+        return result;
+    }
+}
+
+TextureCache::Handle::Handle(Entry *entry) : entry(entry) {
+    if (entry)
+        entry->refCount++;
+}
+
+TextureCache::Handle::Handle(const Handle &other) : Handle(other.entry) {}
+
+TextureCache::Handle::Handle(Handle &&other) noexcept : entry(other.entry) {
+    other.entry = nullptr;
+}
+
+TextureCache::Handle &TextureCache::Handle::operator=(Handle other) {
+    std::swap(entry, other.entry);
+    return *this;
+}
+
+TextureCache::Handle::~Handle() {
+    if (entry)
+        entry->refCount--;
+}
+
+const std::string &TextureCache::Handle::path() const {
+    static const std::string empty;
+    return entry ? entry->path : empty;
+}
+
+TextureCache::Handle TextureCache::acquire(const std::string &path, Format format, bool &isNew) {
+    std::string canonical = canonicalPath(path);
+    std::string key = canonical + '|' + formatNames[static_cast<int>(format)];
+
+    auto found = entries.find(key);
+    if (found != entries.end()) {
+        isNew = false;
+        return Handle(found->second.get());
+    }
+
+    const unsigned char white[4] = {255, 255, 255, 255};
+    const unsigned char flat[4] = {128, 128, 255, 255};
+    bool normalMap = format == Format::NormalMap || format == Format::ImageNormalMap;
+    // the caller's binding on the active unit survives
+    GLint previous = 0;
+    glGetIntegerv(GL_TEXTURE_BINDING_2D, &previous);
+    GLuint texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, normalMap ? flat : white);
+    // complete with its single level until the upload specifies the chain and its own max level
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+    glBindTexture(GL_TEXTURE_2D, (GLuint) previous);
+
+    Entry *entry = new Entry{canonical, format, texture, 0, sizeof(white)};
+    entries[key].reset(entry);
+    isNew = true;
+    return Handle(entry);
+}
+
+void TextureCache::evictUnused() {
+    for (auto it = entries.begin(); it != entries.end();) {
+        Entry &entry = *it->second;
+        if (entry.refCount > 0) {
+            ++it;
+            continue;
+        }
+        if (onEvict)
+            onEvict(entry.path, entry.texture);
+        glDeleteTextures(1, &entry.texture);
+        it = entries.erase(it);
+    }
+}
+
+void TextureCache::setResidentBytes(GLuint texture, size_t bytes) {
+    // once per upload, a scan is cheap enough
+    for (auto &entry: entries) {
+        if (entry.second->texture == texture)
+            entry.second->residentBytes = bytes;
+    }
+}
+
+size_t TextureCache::residentBytes() const {
+    size_t total = 0;
+    for (auto &entry: entries)
+        total += entry.second->residentBytes;
+    return total;
+}
+
+std::vector<TextureCache::Residency> TextureCache::residency() const {
+    std::vector<Residency> result;
+    for (auto &entry: entries)
+        result.push_back(Residency{entry.second->path, entry.second->format, entry.second->residentBytes});
+    std::sort(result.begin(), result.end(), [](const Residency &a, const Residency &b) { return a.bytes > b.bytes; });
+    return result;
+}
+
+std::string TextureCache::canonicalPath(const std::string &path) {
+    std::string resolved = path;
+#ifdef _WIN32
+    char buffer[_MAX_PATH];
+    if (_fullpath(buffer, path.c_str(), _MAX_PATH))
+        resolved = buffer;
+    std::replace(resolved.begin(), resolved.end(), '\\', '/');
+    // NTFS is case insensitive
+    std::transform(resolved.begin(), resolved.end(), resolved.begin(),
+                   [](unsigned char c) { return (char) std::tolower(c); });
+#else
+    char buffer[PATH_MAX];
+    if (realpath(path.c_str(), buffer))
+        resolved = buffer;
+#endif
+    return normalizePath(resolved);
+}
+
+TextureCache &TextureCache::shared() {
+    static TextureCache cache;
+    return cache;
+}
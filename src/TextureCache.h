@@ -0,0 +1,87 @@
+#ifndef GRAPHICS_PROGRAMMING_TEXTURE_CACHE_H
+#define GRAPHICS_PROGRAMMING_TEXTURE_CACHE_H
+
+#include <string>
+#include <memory>
+#include <vector>
+#include <functional>
+#include <unordered_map>
+
+#include "GL/glew.h"
+
+// Process wide registry of image textures, shared by every Model and Texture.
+// An image referenced by several materials or models is decoded and uploaded once.
+// Entries are keyed by canonical path plus format and kept alive by refcounted handles.
+// Must only be used on the thread that owns the GL context.
+class TextureCache
+{
+public:
+    // how the pixels are prepared, the same file in two formats is two textures
+    enum class Format {
+        Diffuse,    // model diffuse map
+        NormalMap,  // model tangent space normal map
+        Image,      // Texture class images, flipped to the OpenGL convention, one per Texture::Usage
+        ImageNormalMap,
+        ImageMask,
+        ImageData
+    };
+
+    // what one texture occupies in video memory
+    struct Residency {
+        std::string path;
+        Format format;
+        size_t bytes;
+    };
+
+private:
+    struct Entry {
+        std::string path;
+        Format format;
+        GLuint texture;
+        int refCount;
+        size_t residentBytes;
+    };
+
+public:
+    class Handle
+    {
+    public:
+        Handle() = default;
+        Handle(const Handle& other);
+        Handle(Handle&& other) noexcept;
+        Handle& operator=(Handle other);
+        ~Handle();
+
+        bool valid() const { return entry != nullptr; }
+        GLuint id() const { return entry ? entry->texture : 0; }
+        const std::string& path() const;
+
+    private:
+        friend class TextureCache;
+        explicit Handle(Entry* entry);
+        Entry* entry = nullptr;
+    };
+
+    // Returns the cached texture. A newly created entry holds a 1x1 placeholder
+    // (white, or a flat normal for normal maps) and isNew tells the caller to upload the pixels.
+    Handle acquire(const std::string& path, Format format, bool& isNew);
+
+    // deletes every texture no handle refers to anymore, onEvict runs before each deletion
+    void evictUnused();
+    std::function<void(const std::string& path, GLuint texture)> onEvict;
+
+    size_t size() const { return entries.size(); }
+
+    // whoever uploads the pixels reports the size of every level it specified
+    void setResidentBytes(GLuint texture, size_t bytes);
+    size_t residentBytes() const;
+    // largest first
+    std::vector<Residency> residency() const;
+
+    static std::string canonicalPath(const std::string& path);
+    static TextureCache& shared();
+
+private:
+    std::unordered_map<std::string, std::unique_ptr<Entry>> entries;
+};
+#endif //GRAPHICS_PROGRAMMING_TEXTURE_CACHE_H
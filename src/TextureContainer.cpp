@@ -0,0 +1,321 @@
+#include "TextureContainer.h"
+
+#include <cstring>
+#include <cstdint>
+#include <cctype>
+#include <iostream>
+#include <algorithm>
+
+namespace {
+    struct DdsPixelFormat {
+        uint32_t size;
+        uint32_t flags;
+        char fourCC[4];
+        uint32_t rgbBitCount;
+        uint32_t masks[4];
+    };
+
+    struct DdsHeader {
+        char magic[4];
+        uint32_t size;
+        uint32_t flags;
+        uint32_t height;
+        uint32_t width;
+        uint32_t pitchOrLinearSize;
+        uint32_t depth;
+        uint32_t mipMapCount;
+        uint32_t reserved1[11];
+        DdsPixelFormat pixelFormat;
+        uint32_t caps[4];
+        uint32_t reserved2;
+    };
+
+    struct DdsHeaderDx10 {
+        uint32_t dxgiFormat;
+        uint32_t resourceDimension;
+        uint32_t miscFlag;
+        uint32_t arraySize;
+        uint32_t miscFlags2;
+    };
+
+    struct Ktx2Header {
+        unsigned char identifier[12];
+        uint32_t vkFormat;
+        uint32_t typeSize;
+        uint32_t pixelWidth;
+        uint32_t pixelHeight;
+        uint32_t pixelDepth;
+        uint32_t layerCount;
+        uint32_t faceCount;
+        uint32_t levelCount;
+        uint32_t supercompressionScheme;
+        uint32_t dfdByteOffset;
+        uint32_t dfdByteLength;
+        uint32_t kvdByteOffset;
+        uint32_t kvdByteLength;
+        uint64_t sgdByteOffset;
+        uint64_t sgdByteLength;
+    };
+
+    struct Ktx2Level {
+        uint64_t byteOffset;
+        uint64_t byteLength;
+        uint64_t uncompressedByteLength;
+    };
+
+    const uint32_t ddsCubeMap = 0x4;
+    const uint32_t ddsCubeMapFaces = 0x200;
+    const unsigned char ktx2Identifier[12] = {0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n'};
+
+    // the renderer samples colour textures as stored, so sRGB variants upload as their UNORM twin
+    GLenum fourCCFormat(const char *fourCC) {
+        if (memcmp(fourCC, "DXT1", 4) == 0)
+            return GL_COMPRESSED_RGBA_S3TC_DXT1_EXT;
+        if (memcmp(fourCC, "DXT3", 4) == 0)
+            return GL_COMPRESSED_RGBA_S3TC_DXT3_EXT;
+        if (memcmp(fourCC, "DXT5", 4) == 0)
+            return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+        if (memcmp(fourCC, "ATI1", 4) == 0 || memcmp(fourCC, "BC4U", 4) == 0)
+            return GL_COMPRESSED_RED_RGTC1;
+        if (memcmp(fourCC, "BC4S", 4) == 0)
+            return GL_COMPRESSED_SIGNED_RED_RGTC1;
+        if (memcmp(fourCC, "ATI2", 4) == 0 || memcmp(fourCC, "BC5U", 4) == 0)
+            return GL_COMPRESSED_RG_RGTC2;
+        if (memcmp(fourCC, "BC5S", 4) == 0)
+            return GL_COMPRESSED_SIGNED_RG_RGTC2;
+        return 0;
+    }
+
+    GLenum dxgiFormat(uint32_t format) {
+        switch (format) {
+            case 71: case 72:
+                return GL_COMPRESSED_RGBA_S3TC_DXT1_EXT;
+            case 74: case 75:
+                return GL_COMPRESSED_RGBA_S3TC_DXT3_EXT;
+            case 77: case 78:
+                return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+            case 80:
+                return GL_COMPRESSED_RED_RGTC1;
+            case 81:
+                return GL_COMPRESSED_SIGNED_RED_RGTC1;
+            case 83:
+                return GL_COMPRESSED_RG_RGTC2;
+            case 84:
+                return GL_COMPRESSED_SIGNED_RG_RGTC2;
+            case 95:
+                return GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT;
+            case 96:
+                return GL_COMPRESSED_RGB_BPTC_SIGNED_FLOAT;
+            case 98: case 99:
+                return GL_COMPRESSED_RGBA_BPTC_UNORM;
+            default:
+                return 0;
+        }
+    }
+
+    GLenum vkFormat(uint32_t format) {
+        switch (format) {
+            case 131: case 132:
+                return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+            case 133: case 134:
+                return GL_COMPRESSED_RGBA_S3TC_DXT1_EXT;
+            case 135: case 136:
+                return GL_COMPRESSED_RGBA_S3TC_DXT3_EXT;
+            case 137: case 138:
+                return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+            case 139:
+                return GL_COMPRESSED_RED_RGTC1;
+            case 140:
+                return GL_COMPRESSED_SIGNED_RED_RGTC1;
+            case 141:
+                return GL_COMPRESSED_RG_RGTC2;
+            case 142:
+                return GL_COMPRESSED_SIGNED_RG_RGTC2;
+            case 143:
+                return GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT;
+            case 144:
+                return GL_COMPRESSED_RGB_BPTC_SIGNED_FLOAT;
+            case 145: case 146:
+                return GL_COMPRESSED_RGBA_BPTC_UNORM;
+            default:
+                return 0;
+        }
+    }
+
+    size_t blockSize(GLenum internalFormat) {
+        switch (internalFormat) {
+            case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+            case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT:
+            case GL_COMPRESSED_RED_RGTC1:
+            case GL_COMPRESSED_SIGNED_RED_RGTC1:
+                return 8;
+            default:
+                return 16;
+        }
+    }
+
+    int mipSize(uint32_t size, int level) {
+        return std::max((int) (size >> level), 1);
+    }
+
+    // floor(log2(max(width, height))) + 1, longer chains are rejected before they reach glTexStorage2D
+    int fullChainLength(uint32_t width, uint32_t height) {
+        int levels = 1;
+        for (uint32_t size = std::max(width, height); size > 1; size >>= 1)
+            levels++;
+        return levels;
+    }
+
+    size_t imageSize(GLenum internalFormat, int width, int height) {
+        return (size_t) ((width + 3) / 4) * ((height + 3) / 4) * blockSize(internalFormat);
+    }
+
+    bool inRange(uint64_t offset, uint64_t size, uint64_t fileSize) {
+        return offset <= fileSize && size <= fileSize - offset;
+    }
+
+    bool hasExtension(const std::string &path, const char *extension) {
+        size_t length = strlen(extension);
+        if (path.size() < length)
+            return false;
+        for (size_t i = 0; i < length; i++) {
+            if (std::tolower((unsigned char) path[path.size() - length + i]) != extension[i])
+                return false;
+        }
+        return true;
+    }
+}
+
+bool TextureContainer::recognizes(const std::string &path) {
+    return hasExtension(path, ".dds") || hasExtension(path, ".ktx2");
+}
+
+bool TextureContainer::open(const std::string &path) {
+    images.clear();
+    if (!file.open(path))
+        return false;
+    bool opened = hasExtension(path, ".ktx2") ? openKtx2(path) : openDds(path);
+    if (!opened) {
+        images.clear();
+        file.close();
+    }
+    return opened;
+}
+
+bool TextureContainer::openDds(const std::string &path) {
+    const unsigned char *base = file.data();
+    uint64_t fileSize = file.size();
+    DdsHeader header{};
+    if (fileSize < sizeof(header))
+        return false;
+    memcpy(&header, base, sizeof(header));
+    if (memcmp(header.magic, "DDS ", 4) != 0 || header.size != sizeof(DdsHeader) - 4 || header.width == 0 ||
+        header.height == 0 || header.depth > 1)
+        return false;
+
+    uint64_t offset = sizeof(header);
+    uint32_t layers = 1;
+    if (memcmp(header.pixelFormat.fourCC, "DX10", 4) == 0) {
+        DdsHeaderDx10 extension{};
+        if (!inRange(offset, sizeof(extension), fileSize))
+            return false;
+        memcpy(&extension, base + offset, sizeof(extension));
+        offset += sizeof(extension);
+        internalFormat = dxgiFormat(extension.dxgiFormat);
+        layers = std::max(extension.arraySize, 1u) * (extension.miscFlag & ddsCubeMap ? 6 : 1);
+    } else {
+        internalFormat = fourCCFormat(header.pixelFormat.fourCC);
+        if (header.caps[1] & ddsCubeMapFaces)
+            layers = 6;
+    }
+    if (internalFormat == 0) {
+        std::cout << "Unsupported DDS format, only BC1 to BC7 are accepted: " << path << std::endl;
+        return false;
+    }
+
+    width = (int) header.width;
+    height = (int) header.height;
+    levelCount = (int) std::max(header.mipMapCount, 1u);
+    layerCount = (int) layers;
+    if (levelCount > fullChainLength(header.width, header.height))
+        return false;
+
+    // DDS stores each layer with its whole chain before the next layer
+    images.resize((size_t) levelCount * layerCount);
+    for (int layer = 0; layer < layerCount; layer++) {
+        for (int level = 0; level < levelCount; level++) {
+            int levelWidth = mipSize(header.width, level), levelHeight = mipSize(header.height, level);
+            size_t size = imageSize(internalFormat, levelWidth, levelHeight);
+            if (!inRange(offset, size, fileSize))
+                return false;
+            images[(size_t) level * layerCount + layer] = Image{levelWidth, levelHeight, base + offset, size};
+            offset += size;
+        }
+    }
+    return true;
+}
+
+bool TextureContainer::openKtx2(const std::string &path) {
+    const unsigned char *base = file.data();
+    uint64_t fileSize = file.size();
+    Ktx2Header header{};
+    if (fileSize < sizeof(header))
+        return false;
+    memcpy(&header, base, sizeof(header));
+    if (memcmp(header.identifier, ktx2Identifier, sizeof(ktx2Identifier)) != 0 || header.pixelWidth == 0 ||
+        header.pixelHeight == 0 || header.pixelDepth > 1 || header.faceCount == 0)
+        return false;
+    internalFormat = vkFormat(header.vkFormat);
+    if (internalFormat == 0 || header.supercompressionScheme != 0) {
+        std::cout << "Unsupported KTX2 texture, only BC1 to BC7 without supercompression are accepted: " << path
+                  << std::endl;
+        return false;
+    }
+
+    width = (int) header.pixelWidth;
+    height = (int) header.pixelHeight;
+    // a level count of 0 asks for runtime generated mips, there is only the base level in the file then
+    levelCount = (int) std::max(header.levelCount, 1u);
+    layerCount = (int) (std::max(header.layerCount, 1u) * header.faceCount);
+    if (levelCount > fullChainLength(header.pixelWidth, header.pixelHeight) ||
+        !inRange(sizeof(header), sizeof(Ktx2Level) * (uint64_t) levelCount, fileSize))
+        return false;
+
+    // KTX2 stores every layer and face of a level together
+    images.resize((size_t) levelCount * layerCount);
+    for (int level = 0; level < levelCount; level++) {
+        Ktx2Level record{};
+        memcpy(&record, base + sizeof(header) + sizeof(Ktx2Level) * level, sizeof(record));
+        int levelWidth = mipSize(header.pixelWidth, level), levelHeight = mipSize(header.pixelHeight, level);
+        size_t size = imageSize(internalFormat, levelWidth, levelHeight);
+        if (record.byteLength != (uint64_t) size * layerCount || !inRange(record.byteOffset, record.byteLength, fileSize))
+            return false;
+        for (int layer = 0; layer < layerCount; layer++) {
+            images[(size_t) level * layerCount + layer] =
+                    Image{levelWidth, levelHeight, base + record.byteOffset + size * layer, size};
+        }
+    }
+    return true;
+}
+
+void TextureContainer::upload(GLenum target) const {
+    if (target == GL_TEXTURE_2D_ARRAY) {
+        glTexStorage3D(target, levelCount, internalFormat, width, height, layerCount);
+        for (int level = 0; level < levelCount; level++) {
+            for (int layer = 0; layer < layerCount; layer++) {
+                const Image &data = image(level, layer);
+                glCompressedTexSubImage3D(target, level, 0, 0, layer, data.width, data.height, 1, internalFormat,
+                                          (GLsizei) data.size, data.data);
+            }
+        }
+    } else {
+        glTexStorage2D(target, levelCount, internalFormat, width, height);
+        for (int level = 0; level < levelCount; level++) {
+            const Image &data = image(level, 0);
+            glCompressedTexSubImage2D(target, level, 0, 0, data.width, data.height, internalFormat,
+                                      (GLsizei) data.size, data.data);
+        }
+    }
+    glTexParameteri(target, GL_TEXTURE_BASE_LEVEL, 0);
+    glTexParameteri(target, GL_TEXTURE_MAX_LEVEL, levelCount - 1);
+}
@@ -0,0 +1,54 @@
+#ifndef GRAPHICS_PROGRAMMING_TEXTURE_CONTAINER_H
+#define GRAPHICS_PROGRAMMING_TEXTURE_CONTAINER_H
+
+#include <string>
+#include <vector>
+#include <cstddef>
+
+#include "GL/glew.h"
+#include "MappedFile.h"
+
+// Precompressed, premipped textures shipped as DDS or KTX2.
+// The file is memory mapped and every image points straight into it, so loading one is pure I/O plus
+// one glCompressedTexSubImage per level and layer. Only block compressed formats (BC1 to BC7) are accepted,
+// KTX2 files must not be supercompressed. Parsing is CPU only, upload needs the GL context.
+class TextureContainer
+{
+public:
+    struct Image {
+        int width;
+        int height;
+        const unsigned char* data;
+        size_t size;
+    };
+
+    GLenum internalFormat = 0;
+    int width = 0;
+    int height = 0;
+    int levelCount = 0;
+    // array layers, cube map faces count as layers
+    int layerCount = 0;
+
+    TextureContainer() = default;
+    TextureContainer(const TextureContainer&) = delete;
+    TextureContainer& operator=(const TextureContainer&) = delete;
+
+    // true for the extensions open understands
+    static bool recognizes(const std::string& path);
+
+    bool open(const std::string& path);
+
+    const Image& image(int level, int layer) const { return images[(size_t) level * layerCount + layer]; }
+
+    // allocates immutable storage on the texture bound to target and uploads every image,
+    // target is GL_TEXTURE_2D for layer 0 only or GL_TEXTURE_2D_ARRAY for all layers
+    void upload(GLenum target) const;
+
+private:
+    MappedFile file;
+    std::vector<Image> images;     // level major
+
+    bool openDds(const std::string& path);
+    bool openKtx2(const std::string& path);
+};
+#endif //GRAPHICS_PROGRAMMING_TEXTURE_CONTAINER_H
@@ -0,0 +1,77 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+
+ThreadPool::ThreadPool(unsigned int threadCount) {
+    if (threadCount == 0)
+        threadCount = 1;
+    workers.reserve(threadCount);
+    for (unsigned int i = 0; i < threadCount; i++)
+        workers.emplace_back(&ThreadPool::workerLoop, this);
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    condition.notify_all();
+    // queued tasks are drained before the workers exit
+    for (auto &worker: workers)
+        worker.join();
+}
+
+void ThreadPool::parallelFor(size_t count, const std::function<void(size_t)> &body) {
+    if (count == 0)
+        return;
+    struct State {
+        std::atomic<size_t> next{0};
+        std::atomic<size_t> done{0};
+        std::mutex mutex;
+        std::condition_variable finished;
+    };
+    // a helper may only get to run after everything is done, it then finds no index left and never touches body
+    auto state = std::make_shared<State>();
+    auto run = [state, count, &body]() {
+        for (size_t i = state->next++; i < count; i = state->next++) {
+            body(i);
+            if (++state->done == count) {
+                std::lock_guard<std::mutex> lock(state->mutex);
+                state->finished.notify_all();
+            }
+        }
+    };
+
+    size_t helpers = std::min(count - 1, workers.size());
+    if (helpers > 0) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (size_t i = 0; i < helpers; i++)
+                tasks.emplace_back(run);
+        }
+        condition.notify_all();
+    }
+    run();
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->finished.wait(lock, [&]() { return state->done == count; });
+}
+
+ThreadPool &ThreadPool::shared() {
+    static ThreadPool pool(std::thread::hardware_concurrency());
+    return pool;
+}
+
+void ThreadPool::workerLoop() {
+    while (true) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            condition.wait(lock, [this]() { return stopping || !tasks.empty(); });
+            if (tasks.empty())
+                return;
+            task = std::move(tasks.front());
+            tasks.pop_front();
+        }
+        task();
+    }
+}
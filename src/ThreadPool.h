@@ -0,0 +1,60 @@
+#ifndef GRAPHICS_PROGRAMMING_THREAD_POOL_H
+#define GRAPHICS_PROGRAMMING_THREAD_POOL_H
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <atomic>
+
+// Fixed size worker pool for CPU-only loading work.
+// Tasks must never touch the GL context, results are handed back through futures.
+class ThreadPool
+{
+public:
+    explicit ThreadPool(unsigned int threadCount);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    template<class F>
+    auto submit(F&& task) -> std::future<decltype(task())>;
+
+    unsigned int size() const { return (unsigned int)workers.size(); }
+
+    // Runs body(0) .. body(count - 1) on the workers and the calling thread, returns once every call is done.
+    // Safe from inside a task: the caller works through the indices itself instead of waiting for a free worker.
+    void parallelFor(size_t count, const std::function<void(size_t)>& body);
+
+    // process wide pool sized to the number of hardware threads
+    static ThreadPool& shared();
+
+private:
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> tasks;
+    std::mutex mutex;
+    std::condition_variable condition;
+    bool stopping = false;
+
+    void workerLoop();
+};
+
+template<class F>
+auto ThreadPool::submit(F&& task) -> std::future<decltype(task())> {
+    using Result = decltype(task());
+    // std::function needs a copyable target, so the packaged task lives on the heap
+    auto packaged = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(task));
+    std::future<Result> result = packaged->get_future();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        tasks.emplace_back([packaged]() { (*packaged)(); });
+    }
+    condition.notify_one();
+    return result;
+}
+#endif //GRAPHICS_PROGRAMMING_THREAD_POOL_H
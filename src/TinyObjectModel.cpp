@@ -3,6 +3,26 @@
 #define TINYOBJLOADER_IMPLEMENTATION
 #include "tiny_obj_loader.h"
 
+namespace {
+    struct IndexKey {
+        int vertex;
+        int normal;
+        int texcoord;
+
+        bool operator==(const IndexKey &other) const {
+            return vertex == other.vertex && normal == other.normal && texcoord == other.texcoord;
+        }
+    };
+
+    struct IndexKeyHash {
+        size_t operator()(const IndexKey &key) const {
+            size_t hash = std::hash<int>()(key.vertex);
+            hash = hash * 31 + std::hash<int>()(key.normal);
+            return hash * 31 + std::hash<int>()(key.texcoord);
+        }
+    };
+}
+
 TinyObjectModel::TinyObjectModel(const std::string &filename) {
     tinyobj::attrib_t attrib;
     std::vector<tinyobj::shape_t> shapes;
@@ -20,48 +40,74 @@ TinyObjectModel::TinyObjectModel(const std::string &filename) {
         exit(1);
     }
 
-    std::vector<float> vertices, normals, tex_coords;  // if OBJ preserves vertex order, you can use element array buffer for memory efficiency
-    for (auto & shape : shapes) {  // for 'ladybug.obj', there is only one object
-        int index_offset = 0;
-        for (int f = 0; f < shape.mesh.num_face_vertices.size(); ++f) {
-            int fv = shape.mesh.num_face_vertices[f];
-            for (int v = 0; v < fv; ++v) {
-                tinyobj::index_t idx = shape.mesh.indices[index_offset + v];
-                vertices.push_back(attrib.vertices[3 * idx.vertex_index + 0]);
-                vertices.push_back(attrib.vertices[3 * idx.vertex_index + 1]);
-                vertices.push_back(attrib.vertices[3 * idx.vertex_index + 2]);
-                normals.push_back(attrib.normals[3 * idx.normal_index + 0]);
-                normals.push_back(attrib.normals[3 * idx.normal_index + 1]);
-                normals.push_back(attrib.normals[3 * idx.normal_index + 2]);
-                tex_coords.push_back(attrib.texcoords[2 * idx.texcoord_index + 0]);
-                tex_coords.push_back(attrib.texcoords[2 * idx.texcoord_index + 1]);
+    // interleaved position, normal, uv
+    const int vsize = 8;
+    size_t cornerCount = 0;
+    for (auto &shape: shapes)
+        cornerCount += shape.mesh.indices.size();
+
+    // corners sharing the same position/normal/uv indices are welded into one vertex
+    std::unordered_map<IndexKey, unsigned int, IndexKeyHash> welded;
+    welded.reserve(attrib.vertices.size() / 3);
+    std::vector<float> vertices;
+    vertices.reserve(attrib.vertices.size() / 3 * vsize);
+    std::vector<unsigned int> indices;
+    indices.reserve(cornerCount);
+
+    for (auto & shape : shapes) {  // LoadObj triangulates, so every face has three corners
+        for (const tinyobj::index_t &idx: shape.mesh.indices) {
+            IndexKey key{idx.vertex_index, idx.normal_index, idx.texcoord_index};
+            auto inserted = welded.emplace(key, (unsigned int) vertexCount);
+            if (inserted.second) {
+                float vertex[vsize] = {};
+                vertex[0] = attrib.vertices[3 * idx.vertex_index + 0];
+                vertex[1] = attrib.vertices[3 * idx.vertex_index + 1];
+                vertex[2] = attrib.vertices[3 * idx.vertex_index + 2];
+                if (idx.normal_index >= 0) {
+                    vertex[3] = attrib.normals[3 * idx.normal_index + 0];
+                    vertex[4] = attrib.normals[3 * idx.normal_index + 1];
+                    vertex[5] = attrib.normals[3 * idx.normal_index + 2];
+                }
+                if (idx.texcoord_index >= 0) {
+                    vertex[6] = attrib.texcoords[2 * idx.texcoord_index + 0];
+                    vertex[7] = attrib.texcoords[2 * idx.texcoord_index + 1];
+                }
+                vertices.insert(vertices.end(), vertex, vertex + vsize);
+                vertexCount++;
             }
-            index_offset += fv;
-            vertexCount += fv;
+            indices.push_back(inserted.first->second);
         }
     }
+    indexCount = (int) indices.size();
 
     glGenVertexArrays(1, &vao);
     glBindVertexArray(vao);
 
     glGenBuffers(1, &vbo);
     glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr) (vertices.size() * sizeof(float)), vertices.data(), GL_STATIC_DRAW);
 
-    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float) + normals.size() * sizeof(float) + tex_coords.size() * sizeof(float), (GLvoid *) nullptr, GL_STATIC_DRAW);
-    glBufferSubData(GL_ARRAY_BUFFER, 0, vertices.size() * sizeof(float), vertices.data());
-    glBufferSubData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), normals.size() * sizeof(float), normals.data());
-    glBufferSubData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float) + normals.size() * sizeof(float), tex_coords.size() * sizeof(float), tex_coords.data());
+    glGenBuffers(1, &ebo);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, (GLsizeiptr) (indices.size() * sizeof(unsigned int)), indices.data(), GL_STATIC_DRAW);
 
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (GLvoid*)nullptr);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, vsize * sizeof(float), (GLvoid*)nullptr);
     glEnableVertexAttribArray(0);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 0, (GLvoid*)(vertices.size() * sizeof(float)));
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, vsize * sizeof(float), (GLvoid*)(3 * sizeof(float)));
     glEnableVertexAttribArray(1);
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 0, (GLvoid*)(vertices.size() * sizeof(float) + normals.size() * sizeof(float)));
+    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, vsize * sizeof(float), (GLvoid*)(6 * sizeof(float)));
     glEnableVertexAttribArray(2);
+    glBindVertexArray(0);
 
-    std::cout << "Loaded model \"" << filename << "\", " << vertexCount << " vertices" << std::endl;
+    std::cout << "Loaded model \"" << filename << "\", " << vertexCount << " vertices, "
+              << indexCount / 3 << " triangles" << std::endl;
 }
 
 void TinyObjectModel::bind() const {
     glBindVertexArray(vao);
 }
+
+void TinyObjectModel::draw() const {
+    glBindVertexArray(vao);
+    glDrawElements(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, nullptr);
+}
\ No newline at end of file
@@ -16,11 +16,14 @@ class TinyObjectModel
 public:
     GLuint vao = 0;			// vertex array object
     GLuint vbo = 0;			// vertex buffer object
-    int vertexCount = 0;
+    GLuint ebo = 0;			// element buffer object
+    int vertexCount = 0;	// unique vertices after welding
+    int indexCount = 0;
 
     // Load .obj model
     explicit TinyObjectModel(const std::string& filename);
 
     void bind() const;
+    void draw() const;
 };
 #endif //GRAPHICS_PROGRAMMING_TINY_OBJECT_MODEL_H
@@ -0,0 +1,143 @@
+#include "UploadQueue.h"
+
+#include <cstring>
+#include <algorithm>
+
+namespace {
+    const size_t stagingAlignment = 16;
+
+    size_t align(size_t offset) {
+        return (offset + stagingAlignment - 1) & ~(stagingAlignment - 1);
+    }
+}
+
+void UploadQueue::uploadBuffer(GLuint buffer, size_t offset, const void *data, size_t size,
+                               std::shared_ptr<const void> owner, std::function<void()> onComplete) {
+    if (size == 0) {
+        if (onComplete)
+            onComplete();
+        return;
+    }
+    requests.push_back(Request{false, buffer, static_cast<const unsigned char *>(data), size, 0, offset, 0, 0, 0, 0,
+                               0, 0, std::move(owner), std::move(onComplete)});
+}
+
+void UploadQueue::uploadTexture(GLuint texture, int width, int height, const unsigned char *pixels,
+                                std::shared_ptr<const void> owner, std::function<void()> onComplete) {
+    if (width <= 0 || height <= 0) {
+        if (onComplete)
+            onComplete();
+        return;
+    }
+    requests.push_back(Request{true, texture, pixels, (size_t) width * height * 4, 0, 0, width, height, 0, 0,
+                               (size_t) width * 4, 1, std::move(owner), std::move(onComplete)});
+}
+
+void UploadQueue::uploadCompressedTexture(GLuint texture, int level, GLenum format, int width, int height,
+                                          const unsigned char *data, size_t size,
+                                          std::shared_ptr<const void> owner, std::function<void()> onComplete) {
+    if (width <= 0 || height <= 0 || size == 0) {
+        if (onComplete)
+            onComplete();
+        return;
+    }
+    size_t blockRows = (size_t) (height + 3) / 4;
+    requests.push_back(Request{true, texture, data, size, 0, 0, width, height, level, format, size / blockRows, 4,
+                               std::move(owner), std::move(onComplete)});
+}
+
+size_t UploadQueue::pendingBytes() const {
+    size_t bytes = 0;
+    for (auto &request: requests)
+        bytes += request.size - request.uploaded;
+    return bytes;
+}
+
+void UploadQueue::process(size_t byteBudget) {
+    if (requests.empty())
+        return;
+
+    // plan this frame's copies, textures advance in whole rows
+    std::vector<Copy> copies;
+    size_t used = 0;
+    size_t stagingEnd = 0;
+    for (auto &request: requests) {
+        size_t remaining = request.size - request.uploaded;
+        size_t chunk;
+        if (request.isTexture) {
+            size_t rowBytes = request.rowBytes;
+            size_t rows = std::min(remaining / rowBytes, (byteBudget > used ? byteBudget - used : 0) / rowBytes);
+            if (rows == 0 && copies.empty())
+                rows = 1;
+            chunk = rows * rowBytes;
+        } else {
+            chunk = std::min(remaining, byteBudget > used ? byteBudget - used : 0);
+        }
+        if (chunk == 0)
+            break;
+        size_t stagingOffset = align(stagingEnd);
+        copies.push_back(Copy{&request, request.uploaded, stagingOffset, chunk});
+        stagingEnd = stagingOffset + chunk;
+        used += chunk;
+        if (chunk < remaining)
+            break;
+    }
+    if (copies.empty())
+        return;
+
+    if (stagingBuffer == 0)
+        glGenBuffers(1, &stagingBuffer);
+    stagingSize = std::max(stagingSize, stagingEnd);
+
+    // orphan the previous frame's storage so mapping never waits on copies still in flight
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, stagingBuffer);
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, (GLsizeiptr) stagingSize, nullptr, GL_STREAM_DRAW);
+    auto *staging = static_cast<unsigned char *>(glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, (GLsizeiptr) stagingEnd,
+                                                                  GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT));
+    if (staging == nullptr) {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        return;
+    }
+    for (auto &copy: copies)
+        memcpy(staging + copy.stagingOffset, copy.request->data + copy.sourceOffset, copy.size);
+    glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+    glBindBuffer(GL_COPY_READ_BUFFER, stagingBuffer);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    for (auto &copy: copies) {
+        Request &request = *copy.request;
+        if (request.isTexture) {
+            int y = (int) (copy.sourceOffset / request.rowBytes) * request.rowHeight;
+            int height = std::min((int) (copy.size / request.rowBytes) * request.rowHeight, request.height - y);
+            glBindTexture(GL_TEXTURE_2D, request.target);
+            if (request.compressedFormat != 0)
+                glCompressedTexSubImage2D(GL_TEXTURE_2D, request.level, 0, y, request.width, height,
+                                          request.compressedFormat, (GLsizei) copy.size, (GLvoid *) copy.stagingOffset);
+            else
+                glTexSubImage2D(GL_TEXTURE_2D, request.level, 0, y, request.width, height, GL_RGBA, GL_UNSIGNED_BYTE,
+                                (GLvoid *) copy.stagingOffset);
+        } else {
+            glBindBuffer(GL_COPY_WRITE_BUFFER, request.target);
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, (GLintptr) copy.stagingOffset,
+                                (GLintptr) (request.destinationOffset + copy.sourceOffset), (GLsizeiptr) copy.size);
+        }
+        request.uploaded += copy.size;
+    }
+    // a bound unpack buffer would turn every later glTexImage2D pointer into an offset
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    while (!requests.empty() && requests.front().uploaded == requests.front().size) {
+        Request finished = std::move(requests.front());
+        requests.pop_front();
+        if (finished.onComplete)
+            finished.onComplete();
+    }
+}
+
+UploadQueue &UploadQueue::shared() {
+    static UploadQueue queue;
+    return queue;
+}
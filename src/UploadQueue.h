@@ -0,0 +1,71 @@
+#ifndef GRAPHICS_PROGRAMMING_UPLOAD_QUEUE_H
+#define GRAPHICS_PROGRAMMING_UPLOAD_QUEUE_H
+
+#include <deque>
+#include <vector>
+#include <memory>
+#include <functional>
+#include <cstddef>
+
+#include "GL/glew.h"
+
+// Spreads buffer and texture uploads over several frames.
+// Data is copied into an orphaned staging buffer object and reaches its destination through
+// glCopyBufferSubData or a pixel unpack glTexSubImage2D, never more than the given budget per call.
+// Must only be used on the thread that owns the GL context.
+class UploadQueue
+{
+public:
+    UploadQueue() = default;
+
+    UploadQueue(const UploadQueue&) = delete;
+    UploadQueue& operator=(const UploadQueue&) = delete;
+
+    // owner keeps data alive until onComplete has run, the destination storage must already exist
+    void uploadBuffer(GLuint buffer, size_t offset, const void* data, size_t size,
+                      std::shared_ptr<const void> owner, std::function<void()> onComplete);
+    // RGBA8 pixels for level 0, uploaded in row bands
+    void uploadTexture(GLuint texture, int width, int height, const unsigned char* pixels,
+                       std::shared_ptr<const void> owner, std::function<void()> onComplete);
+    // one level of a block compressed texture whose storage is already specified, uploaded in rows of blocks
+    void uploadCompressedTexture(GLuint texture, int level, GLenum format, int width, int height,
+                                 const unsigned char* data, size_t size,
+                                 std::shared_ptr<const void> owner, std::function<void()> onComplete);
+
+    // copies at most byteBudget bytes, a single texture row larger than the budget still goes through
+    void process(size_t byteBudget);
+
+    bool empty() const { return requests.empty(); }
+    size_t pendingBytes() const;
+
+    static UploadQueue& shared();
+
+private:
+    struct Request {
+        bool isTexture;
+        GLuint target;
+        const unsigned char* data;
+        size_t size;
+        size_t uploaded;
+        size_t destinationOffset;
+        int width;
+        int height;
+        int level;
+        GLenum compressedFormat;    // 0 for RGBA8 pixels
+        size_t rowBytes;            // textures advance in whole rows, of texels or of 4x4 blocks
+        int rowHeight;
+        std::shared_ptr<const void> owner;
+        std::function<void()> onComplete;
+    };
+    struct Copy {
+        Request* request;
+        size_t sourceOffset;
+        size_t stagingOffset;
+        size_t size;
+    };
+
+    std::deque<Request> requests;
+    GLuint stagingBuffer = 0;
+    size_t stagingSize = 0;
+};
+#endif //GRAPHICS_PROGRAMMING_UPLOAD_QUEUE_H
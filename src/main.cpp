@@ -4,6 +4,8 @@
 #include <iostream>
 #include <string>
 #include <ctime>
+#include <cmath>
+#include <algorithm>
 
 // include OpenGL
 #include "GL/glew.h"
@@ -20,16 +22,22 @@
 
 #include "Common.h"
 #include "Shader.h"
+#include "ShaderVariants.h"
 #include "Model.h"
 #include "Camera.h"
-#include "Area_Light_LTC.h"
+#include "LtcTables.h"
+#include "StartupProfiler.h"
 
 const float FOV = 72.0;
+// bytes of streamed mesh/texture data uploaded per frame
+const size_t STREAMING_UPLOAD_BUDGET = 8 * 1024 * 1024;
 int WIDTH = 1600;
 int HEIGHT = 900;
 
 Camera *camera;
 Shader *shader;
+// permutations of texture.frag, shader is the one matching renderConfig
+ShaderVariants *textureShaders;
 Shader* shadowMapShader;
 Shader *screenShader;
 Shader* gbufferShader;
@@ -134,6 +142,9 @@ struct RenderConfig {
     bool SSAO = false;
     bool FXAA = false;
     bool Area_Light = false;
+    float lod_pixel_error = 1.0f;   // largest simplification error allowed on screen, in pixels
+    int  shadow_lod = 1;            // shadow maps are low resolution, a fixed coarser level is enough
+    bool cluster_culling = true;
 } renderConfig;
 
 //imgui state
@@ -141,32 +152,156 @@ bool show_demo_window = false;
 glm::vec3 cameraPosition;
 glm::vec3 cameraLookat;
 
-GLuint loadMTexture()
-{
-    GLuint texture = 0;
-    glGenTextures(1, &texture);
-    glBindTexture(GL_TEXTURE_2D, texture);
+// uniforms set per model and per mesh, resolved once after the programs are linked
+struct MeshUniforms {
+    UniformHandle<bool> compactVertices;
+    UniformHandle<glm::vec3> positionScale;
+    UniformHandle<glm::vec3> positionOffset;
+    UniformHandle<bool> hasTexture;
+    UniformHandle<bool> hasNormalMap;
+    UniformHandle<glm::vec3> ambient;
+    UniformHandle<glm::vec3> diffuse;
+    UniformHandle<glm::vec3> specular;
+    UniformHandle<float> shininess;
+
+    MeshUniforms() = default;
+    explicit MeshUniforms(const Shader *program)
+            : compactVertices(program->uniform<bool>("compactVertices")),
+              positionScale(program->uniform<glm::vec3>("positionScale")),
+              positionOffset(program->uniform<glm::vec3>("positionOffset")),
+              hasTexture(program->uniform<bool>("hasTexture")),
+              hasNormalMap(program->uniform<bool>("hasNormalMap")),
+              ambient(program->uniform<glm::vec3>("material.ambient")),
+              diffuse(program->uniform<glm::vec3>("material.diffuse")),
+              specular(program->uniform<glm::vec3>("material.specular")),
+              shininess(program->uniform<float>("material.shininess")) {}
+};
+MeshUniforms shaderUniforms;
+MeshUniforms gbufferUniforms;
+MeshUniforms shadowMapUniforms;
+MeshUniforms pointShadowUniforms;
+UniformHandle<glm::mat4> shadowMatrixUniforms[6];
+
+// the vertex shaders dequantize Model::VertexFormat::Compact attributes with these
+void setVertexFormat(const MeshUniforms &uniforms, const Model *model) {
+    uniforms.compactVertices.set(model->vertexFormat == Model::VertexFormat::Compact);
+    uniforms.positionScale.set(model->positionScale);
+    uniforms.positionOffset.set(model->positionOffset);
+}
 
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 64, 64,
-        0, GL_RGBA, GL_FLOAT, LTC1);
+// everything but hasNormalMap, which depends on the pass
+void setMaterial(const MeshUniforms &uniforms, const Model::Material &material) {
+    uniforms.hasTexture.set(material.hasTexture);
+    uniforms.ambient.set(material.ambientColor);
+    uniforms.diffuse.set(material.diffuseColor);
+    uniforms.specular.set(material.specularColor);
+    uniforms.shininess.set(material.shininess);
+}
 
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+// texture.frag features, bit i of a variant mask is textureFeatures[i]
+const std::vector<std::string> textureFeatures = {"BLINN_PHONG", "DIRECTIONAL_LIGHT_SHADOW", "BLOOM", "NPR", "SSAO",
+                                                  "AREA_LIGHT"};
+
+uint32_t textureVariantMask() {
+    const bool enabled[] = {renderConfig.blinn_phong, renderConfig.directional_light_shadow, renderConfig.bloom,
+                            renderConfig.NPR, renderConfig.SSAO, renderConfig.Area_Light};
+    uint32_t mask = 0;
+    for (uint32_t i = 0; i < sizeof(enabled) / sizeof(enabled[0]); i++)
+        mask |= enabled[i] ? 1u << i : 0u;
+    return mask;
+}
 
-    glBindTexture(GL_TEXTURE_2D, 0);
-    return texture;
+// Points shader at the variant for the current renderConfig once it has linked, a toggled feature
+// keeps drawing with the previous variant while the new one compiles.
+void selectTextureShader() {
+    Shader *variant = textureShaders->get(textureVariantMask());
+    if (variant != shader && variant->isReady()) {
+        shader = variant;
+        shaderUniforms = MeshUniforms(shader);
+    }
+}
+
+// Polls every program draw() needs with the current renderConfig, so each finishes as soon as the driver is done.
+// Rendering starts once they are all ready, the models keep streaming in meanwhile.
+bool shadersReady() {
+    Shader *required[] = {shader ? shader : textureShaders->get(textureVariantMask()), shadowMapShader,
+                          pointLightShadowMapShader, gbufferShader, screenShader,
+                          renderConfig.bloom ? BloomEffect_BlurShader : nullptr,
+                          renderConfig.SSAO ? ssaoEffectShader : nullptr,
+                          renderConfig.FXAA ? FXAA_Shader : nullptr,
+                          renderConfig.Area_Light ? areaLightShader : nullptr};
+    bool ready = true;
+    for (Shader *program: required)
+        ready = (!program || program->isReady()) && ready;
+    static bool resolved = false;
+    if (ready && !resolved) {
+        resolved = true;
+        gbufferUniforms = MeshUniforms(gbufferShader);
+        shadowMapUniforms = MeshUniforms(shadowMapShader);
+        pointShadowUniforms = MeshUniforms(pointLightShadowMapShader);
+        for (int i = 0; i < 6; i++)
+            shadowMatrixUniforms[i] = pointLightShadowMapShader->uniform<glm::mat4>("shadowMatrices[" + std::to_string(i) + "]");
+    }
+    return ready;
+}
+
+// meshes of one geometry arena block share a VAO, so consecutive draws skip the rebind
+GLuint boundVertexArray = 0;
+void bindVertexArray(GLuint vao) {
+    if (vao != boundVertexArray) {
+        glBindVertexArray(vao);
+        boundVertexArray = vao;
+    }
+}
+
+Model::ClusterDraws clusterDraws;
+// clusters drawn and considered over the last frame
+unsigned int clustersVisible = 0;
+unsigned int clustersTotal = 0;
+// uniform writes sent and skipped as redundant over the last frame
+UniformStats frameUniformStats;
+
+// Draws one level of a mesh's LOD chain, levels past the last one fall back to the coarsest.
+// With cluster culling on, only the clusters inside view are drawn.
+void drawMesh(const Model *model, const Model::Mesh &mesh, unsigned int lod, const glm::mat4 &modelMatrix,
+              const Model::ClusterView &view) {
+    if (mesh.indicesCount == 0 || mesh.lods.empty())
+        return;
+    const Model::Lod &level = mesh.lods[std::min<size_t>(lod, mesh.lods.size() - 1)];
+    if (!renderConfig.cluster_culling) {
+        size_t indexSize = mesh.indexType == GL_UNSIGNED_SHORT ? 2 : 4;
+        glDrawElementsBaseVertex(GL_TRIANGLES, (GLsizei) level.indexCount, mesh.indexType,
+                                 (GLvoid *) (mesh.indexOffset + level.indexOffset * indexSize), mesh.baseVertex);
+        clustersVisible += level.meshletCount;
+        clustersTotal += level.meshletCount;
+        return;
+    }
+    model->cullClusters(mesh, lod, modelMatrix, view, clusterDraws);
+    clustersVisible += clusterDraws.visible;
+    clustersTotal += clusterDraws.total;
+    if (!clusterDraws.counts.empty())
+        glMultiDrawElementsBaseVertex(GL_TRIANGLES, clusterDraws.counts.data(), mesh.indexType,
+                                      clusterDraws.offsets.data(), (GLsizei) clusterDraws.counts.size(),
+                                      clusterDraws.baseVertices.data());
 }
 
-GLuint loadLUTTexture()
+// LOD for a camera pass, the error is projected with the main camera's vertical FOV
+unsigned int viewLod(const Model::Mesh &mesh, const glm::mat4 &model) {
+    float projectionScale = (float) HEIGHT / (2.0f * std::tan(glm::radians(FOV) * 0.5f));
+    return Model::selectLod(mesh, model, camera->position, projectionScale, renderConfig.lod_pixel_error);
+}
+
+// RGBA16F straight from the mapped blob, half the memory and bandwidth of the float tables it was made from
+GLuint loadLTCTexture(const LtcTables &tables, int index)
 {
     GLuint texture = 0;
     glGenTextures(1, &texture);
     glBindTexture(GL_TEXTURE_2D, texture);
 
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 64, 64,
-        0, GL_RGBA, GL_FLOAT, LTC2);
+    glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA16F, LtcTables::size, LtcTables::size);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, LtcTables::size, LtcTables::size, GL_RGBA, GL_HALF_FLOAT,
+                    tables.table(index));
 
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
@@ -190,15 +325,17 @@ void init() {
     camera = new Camera(glm::vec3(4.0, 1.5, -2.0), -195, -15);
     cameraPosition = camera->position;
     cameraLookat = camera->getLookAt();
-    gray_room = new Model("assets/indoor/Grey_White_Room.obj");
-    trice = new Model("assets/indoor/trice.obj");
-    shader = new Shader("shader/texture.vert", "shader/texture.frag");
+    // models stream in over the first frames instead of blocking startup, and the shaders compile meanwhile
+    Shader::enableParallelCompile();
+    gray_room = new Model("assets/indoor/Grey_White_Room.obj", true, Model::VertexFormat::Compact);
+    trice = new Model("assets/indoor/trice.obj", true, Model::VertexFormat::Compact);
+    textureShaders = new ShaderVariants("shader/texture.vert", "shader/texture.frag", textureFeatures);
     shadowMapShader = new Shader("shader/shadowMap.vert", "shader/shadowMap.frag");
     pointLightShadowMapShader = new Shader("shader/pointShadowMap.vert", "shader/pointShadowMap.frag", "shader/pointShadowMap.geom");
     screenShader = new Shader("shader/screen.vert", "shader/screen.frag");
     gbufferShader = new Shader("shader/GBuffer.vert", "shader/GBuffer.frag");
     /*----- Bloom Effect Object/Shader Begin ----- */
-    emissive_sphere = new Model("assets/indoor/sphere.obj");
+    emissive_sphere = new Model("assets/indoor/sphere.obj", true, Model::VertexFormat::Compact);
     BloomEffect_BlurShader = new Shader("shader/BloomEffectBlur.vert", "shader/BloomEffectBlur.frag");
     /*----- Bloom Effect Object/Shader End ----- */
 
@@ -214,6 +351,10 @@ void init() {
     areaLightShader = new Shader("shader/AreaLight.vert", "shader/AreaLight.frag");
     /*----- Area Light Shader End -----*/
 
+    // programs link in the background, shadersReady resolves their uniforms once they are done
+
+    // framebuffers and their attachments, up to the point light shadow
+    StartupProfiler::Scope renderTargets("Render targets");
     // directional light shadow
     glGenFramebuffers(1, &depthMapFBO);
     glBindFramebuffer(GL_FRAMEBUFFER, depthMapFBO);
@@ -437,13 +578,21 @@ void init() {
     glDrawBuffer(GL_NONE);
     glReadBuffer(GL_NONE);
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    renderTargets.stop();
     
 
     /*----- Area Light Init. Begin -----*/
     // position (1.0, 0.5, -0.5)
     
-    mLTC.mat1 = loadMTexture();
-    mLTC.mat2 = loadLUTTexture();
+    StartupProfiler::Scope ltcUpload("LTC upload");
+    LtcTables ltcTables;
+    if (ltcTables.open("assets/ltc_tables.bin")) {
+        mLTC.mat1 = loadLTCTexture(ltcTables, 0);
+        mLTC.mat2 = loadLTCTexture(ltcTables, 1);
+    } else {
+        std::cout << "Failed to load assets/ltc_tables.bin, the area light is unavailable" << std::endl;
+    }
+    ltcUpload.stop();
 
     glGenVertexArrays(1, &areaLightVAO);
     glBindVertexArray(areaLightVAO);
@@ -492,15 +641,6 @@ void init() {
 	glEnableVertexAttribArray(1);
 	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (GLvoid*)(2 * sizeof(float)));
 
-    // setup shaders
-    shader->use();
-    shader->setVec3("directionalLight.position", directionalLight_position);
-    shader->setVec3("directionalLight.ambient", glm::vec3(0.1));
-    shader->setVec3("directionalLight.diffuse", glm::vec3(0.7));
-    shader->setVec3("directionalLight.specular", glm::vec3(0.2));
-    shader->setInt("shadowMap", 4);
-    shader->setInt("textureMap", 0);
-
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
     glUseProgram(0);
 }
@@ -523,7 +663,7 @@ void drawToScreen() {
     screenShader->setBool("config.deferredShading", renderConfig.deferred_shading);
     screenShader->setBool("config.normalMapping", renderConfig.normal_mapping);
     screenShader->setBool("config.NPR", renderConfig.NPR);
-    glBindVertexArray(frameVAO);
+    bindVertexArray(frameVAO);
 
     /*----- Post Process Textures Binding Begin ----- */
     glActiveTexture(GL_TEXTURE1);
@@ -561,7 +701,7 @@ void drawToScreen() {
         glClearColor(0.19, 0.19, 0.19, 1.0);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
         FXAA_Shader->use();
-        glBindVertexArray(frameVAO);
+        bindVertexArray(frameVAO);
         glActiveTexture(GL_TEXTURE9);
         glBindTexture(GL_TEXTURE_2D, FXAA_Texture);
         FXAA_Shader->setInt("Texture", 9);
@@ -572,10 +712,21 @@ void drawToScreen() {
 
 void draw() {
     //Global Setting
+    // streaming and ImGui bind VAOs behind bindVertexArray's back
+    glBindVertexArray(0);
+    boundVertexArray = 0;
     glEnable(GL_STENCIL_TEST);
     glStencilFunc(GL_ALWAYS, 1, 0xFF);
     glStencilOp(GL_KEEP, GL_KEEP, GL_REPLACE);
     glStencilMask(0x00);
+    glm::mat4 trice_matrix = glm::scale(glm::translate(glm::mat4(1.0), glm::vec3(2.05, 0.628725, -1.9)), glm::vec3(0.001));
+    glm::mat4 emissive_sphere_matrix = glm::scale(glm::translate(glm::mat4(1.0), emissive_sphere_position), glm::vec3(0.22));
+    // the cone test drops back facing clusters, which a two sided renderer still draws
+    Model::ClusterView cameraView = Model::ClusterView::frustum(projection_matrix * camera->getViewMatrix(),
+                                                                camera->position, glIsEnabled(GL_CULL_FACE) == GL_TRUE);
+    clustersVisible = clustersTotal = 0;
+    frameUniformStats = Shader::uniformStats();
+    Shader::uniformStats() = UniformStats();
     // Shadow
     // Compute the MVP matrix from the light's point of view
     glm::mat4 depthProjectionMatrix = glm::ortho<float>(-5, 5, -5, 5, 0.1, 10);
@@ -589,6 +740,8 @@ void draw() {
         0.5, 0.5, 0.5, 1.0
     );
     glm::mat4 depthBiasVP = biasMatrix * depthVP;
+    // orthographic, the cone test would need the light direction rather than a position
+    Model::ClusterView directionalShadowView = Model::ClusterView::frustum(depthVP, directionalLight_position, false);
     
     glViewport(0, 0, 1024, 1024);
     glBindFramebuffer(GL_FRAMEBUFFER, depthMapFBO);
@@ -600,20 +753,23 @@ void draw() {
     glBindTexture(GL_TEXTURE_2D, depthMap);
 
     shadowMapShader->setMat4("M", glm::mat4(1.0));
+    setVertexFormat(shadowMapUniforms, gray_room);
     for (auto &mesh: gray_room->meshes) {
-        glBindVertexArray(mesh.vao);
-        glDrawElements(GL_TRIANGLES, (GLint) mesh.indicesCount, GL_UNSIGNED_INT, (GLvoid *) nullptr);
+        bindVertexArray(mesh.vao);
+        drawMesh(gray_room, mesh, renderConfig.shadow_lod, glm::mat4(1.0), directionalShadowView);
     }
-    shadowMapShader->setMat4("M", glm::scale(glm::translate(glm::mat4(1.0), glm::vec3(2.05, 0.628725, -1.9)), glm::vec3(0.001)));
+    shadowMapShader->setMat4("M", trice_matrix);
+    setVertexFormat(shadowMapUniforms, trice);
     for (auto &mesh: trice->meshes) {
-        glBindVertexArray(mesh.vao);
-        glDrawElements(GL_TRIANGLES, (GLint) mesh.indicesCount, GL_UNSIGNED_INT, (GLvoid *) nullptr);
+        bindVertexArray(mesh.vao);
+        drawMesh(trice, mesh, renderConfig.shadow_lod, trice_matrix, directionalShadowView);
     }
 
     // Point Light Shadow Pass
     float near_plane = 0.22f;
     float far_plane = 10.0f;
     glm::mat4 shadowProj = glm::perspective(glm::radians(90.0f), 1.0f, near_plane, far_plane);
+    Model::ClusterView pointShadowView = Model::ClusterView::sphere(emissive_sphere_position, far_plane);
     glm::mat4 shadowTransforms[6];
     shadowTransforms[0] = shadowProj * glm::lookAt(emissive_sphere_position, emissive_sphere_position+ glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f));
     shadowTransforms[1] = shadowProj * glm::lookAt(emissive_sphere_position, emissive_sphere_position+ glm::vec3(-1.0f, 0.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f));
@@ -627,18 +783,20 @@ void draw() {
     glClear(GL_DEPTH_BUFFER_BIT);
     pointLightShadowMapShader->use();
     for (unsigned int i = 0; i < 6; ++i)
-        pointLightShadowMapShader->setMat4("shadowMatrices[" + std::to_string(i) + "]", shadowTransforms[i]);
+        shadowMatrixUniforms[i].set(shadowTransforms[i]);
     pointLightShadowMapShader->setFloat("far_plane", far_plane);
     pointLightShadowMapShader->setVec3("lightPos", emissive_sphere_position);
     pointLightShadowMapShader->setMat4("model", glm::mat4(1.0));
+    setVertexFormat(pointShadowUniforms, gray_room);
     for (auto& mesh : gray_room->meshes) {
-        glBindVertexArray(mesh.vao);
-        glDrawElements(GL_TRIANGLES, (GLint)mesh.indicesCount, GL_UNSIGNED_INT, (GLvoid*) nullptr);
+        bindVertexArray(mesh.vao);
+        drawMesh(gray_room, mesh, renderConfig.shadow_lod, glm::mat4(1.0), pointShadowView);
     }
-    pointLightShadowMapShader->setMat4("model", glm::scale(glm::translate(glm::mat4(1.0), glm::vec3(2.05, 0.628725, -1.9)), glm::vec3(0.001)));
+    pointLightShadowMapShader->setMat4("model", trice_matrix);
+    setVertexFormat(pointShadowUniforms, trice);
     for (auto& mesh : trice->meshes) {
-        glBindVertexArray(mesh.vao);
-        glDrawElements(GL_TRIANGLES, (GLint)mesh.indicesCount, GL_UNSIGNED_INT, (GLvoid*) nullptr);
+        bindVertexArray(mesh.vao);
+        drawMesh(trice, mesh, renderConfig.shadow_lod, trice_matrix, pointShadowView);
     }
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
     //glActiveTexture(GL_TEXTURE0);
@@ -650,36 +808,29 @@ void draw() {
     gbufferShader->setMat4("model", model_matrix);
     gbufferShader->setMat4("view", camera->getViewMatrix());
     gbufferShader->setMat4("projection", projection_matrix);
+    setVertexFormat(gbufferUniforms, gray_room);
+    gbufferShader->setInt("tex_diffuse", 0);
+    gbufferUniforms.hasNormalMap.set(false);
     for (auto& mesh : gray_room->meshes) {
-        glBindVertexArray(mesh.vao);
-        gbufferShader->setBool("hasTexture", gray_room->materials[mesh.materialID].hasTexture);
-        gbufferShader->setBool("hasNormalMap", false);
-        gbufferShader->setInt("tex_diffuse", 0);
-        gbufferShader->setVec3("material.ambient", gray_room->materials[mesh.materialID].ambientColor);
-        gbufferShader->setVec3("material.diffuse", gray_room->materials[mesh.materialID].diffuseColor);
-        gbufferShader->setVec3("material.specular", gray_room->materials[mesh.materialID].specularColor);
-        gbufferShader->setFloat("material.shininess", gray_room->materials[mesh.materialID].shininess);
+        bindVertexArray(mesh.vao);
+        setMaterial(gbufferUniforms, gray_room->materials[mesh.materialID]);
         glActiveTexture(GL_TEXTURE0);
         glBindTexture(GL_TEXTURE_2D, gray_room->materials[mesh.materialID].textureID);
-        glDrawElements(GL_TRIANGLES, (GLint)mesh.indicesCount, GL_UNSIGNED_INT, (GLvoid*) nullptr);
+        drawMesh(gray_room, mesh, viewLod(mesh, model_matrix), model_matrix, cameraView);
     }
 
-    gbufferShader->setMat4("model", glm::scale(glm::translate(glm::mat4(1.0), glm::vec3(2.05, 0.628725, -1.9)), glm::vec3(0.001)));
+    gbufferShader->setMat4("model", trice_matrix);
+    setVertexFormat(gbufferUniforms, trice);
+    gbufferShader->setInt("NormalMap", 6);
     for (auto& mesh : trice->meshes) {
-        glBindVertexArray(mesh.vao);
-        gbufferShader->setBool("hasTexture", trice->materials[mesh.materialID].hasTexture);
-        gbufferShader->setBool("hasNormalMap", trice->materials[mesh.materialID].hasNormalMap && renderConfig.normal_mapping);
-        gbufferShader->setInt("tex_diffuse", 0);
-        gbufferShader->setInt("NormalMap", 6);
-        gbufferShader->setVec3("material.ambient", trice->materials[mesh.materialID].ambientColor);
-        gbufferShader->setVec3("material.diffuse", trice->materials[mesh.materialID].diffuseColor);
-        gbufferShader->setVec3("material.specular", trice->materials[mesh.materialID].specularColor);
-        gbufferShader->setFloat("material.shininess", trice->materials[mesh.materialID].shininess);
+        bindVertexArray(mesh.vao);
+        setMaterial(gbufferUniforms, trice->materials[mesh.materialID]);
+        gbufferUniforms.hasNormalMap.set(trice->materials[mesh.materialID].hasNormalMap && renderConfig.normal_mapping);
         glActiveTexture(GL_TEXTURE0);
         glBindTexture(GL_TEXTURE_2D, trice->materials[mesh.materialID].textureID);
         glActiveTexture(GL_TEXTURE6);
         glBindTexture(GL_TEXTURE_2D, trice->materials[mesh.materialID].NormalMapID);
-        glDrawElements(GL_TRIANGLES, (GLint)mesh.indicesCount, GL_UNSIGNED_INT, (GLvoid*) nullptr);
+        drawMesh(trice, mesh, viewLod(mesh, trice_matrix), trice_matrix, cameraView);
     }
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
     // 
@@ -710,7 +861,7 @@ void draw() {
         ssaoEffectShader->setVec2("noise_scale", glm::vec2(WIDTH / 4, HEIGHT / 4));
 
 
-        glBindVertexArray(SSAO_VAO);
+        bindVertexArray(SSAO_VAO);
         glBindBufferBase(GL_UNIFORM_BUFFER, 0, uboSSAOkernel);
         glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
     }
@@ -725,16 +876,15 @@ void draw() {
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
     glViewport(0, 0, WIDTH, HEIGHT);
     // projection & view matrix
+    selectTextureShader();
     shader->use();
     shader->setMat4("depthMVP", depthBiasVP);
-    shader->setBool("config.blinnPhong", renderConfig.blinn_phong);
-    shader->setBool("config.directionalLightShadow", renderConfig.directional_light_shadow);
-    shader->setBool("config.bloom", renderConfig.bloom);
-    shader->setBool("config.deferredShading", renderConfig.deferred_shading);
-    shader->setBool("config.normalMapping", renderConfig.normal_mapping);
-    shader->setBool("config.NPR", renderConfig.NPR);
-    shader->setBool("config.areaLight", renderConfig.Area_Light);
     shader->setVec3("directionalLight.position", directionalLight_position);
+    shader->setVec3("directionalLight.ambient", glm::vec3(0.1));
+    shader->setVec3("directionalLight.diffuse", glm::vec3(0.7));
+    shader->setVec3("directionalLight.specular", glm::vec3(0.2));
+    shader->setInt("shadowMap", 4);
+    shader->setInt("textureMap", 0);
 
     // point light shadow
     shader->setFloat("farPlane", far_plane);
@@ -745,7 +895,6 @@ void draw() {
     /*----- Bloom Effect Setting Begin ----- */
     if (renderConfig.bloom) shader->setVec3("emissive_sphere_position", emissive_sphere_position);
     /*----- Bloom Effect Setting End ----- */
-    shader->setBool("config.SSAO", renderConfig.SSAO);
     shader->setBool("isLightObject", false);
 
     shader->setMat4("model", model_matrix);
@@ -785,41 +934,36 @@ void draw() {
         shader->setInt("LTC2", 12);
     }
 
+    setVertexFormat(shaderUniforms, gray_room);
+    shaderUniforms.hasNormalMap.set(false);
+
     for (auto &mesh: gray_room->meshes) {
         glActiveTexture(GL_TEXTURE0);
         glBindTexture(GL_TEXTURE_2D, gray_room->materials[mesh.materialID].textureID);
-        glBindVertexArray(mesh.vao);
-        shader->setBool("hasTexture", gray_room->materials[mesh.materialID].hasTexture);
-        shader->setBool("hasNormalMap", false);
-        shader->setVec3("material.ambient", gray_room->materials[mesh.materialID].ambientColor);
-        shader->setVec3("material.diffuse", gray_room->materials[mesh.materialID].diffuseColor);
-        shader->setVec3("material.specular", gray_room->materials[mesh.materialID].specularColor);
-        shader->setFloat("material.shininess", gray_room->materials[mesh.materialID].shininess);
-        glDrawElements(GL_TRIANGLES, (GLint) mesh.indicesCount, GL_UNSIGNED_INT, (GLvoid *) nullptr);
+        bindVertexArray(mesh.vao);
+        setMaterial(shaderUniforms, gray_room->materials[mesh.materialID]);
+        drawMesh(gray_room, mesh, viewLod(mesh, model_matrix), model_matrix, cameraView);
     }
 
-    shader->setMat4("model", glm::scale(glm::translate(glm::mat4(1.0), glm::vec3(2.05, 0.628725, -1.9)), glm::vec3(0.001)));
+    shader->setMat4("model", trice_matrix);
+    setVertexFormat(shaderUniforms, trice);
+    shader->setInt("NormalMap", 5);
+    shader->setInt("textureMap", 0);
     for (auto &mesh: trice->meshes) {
         glActiveTexture(GL_TEXTURE0);
         glBindTexture(GL_TEXTURE_2D, trice->materials[mesh.materialID].textureID);
-        shader->setInt("NormalMap", 5);
         glActiveTexture(GL_TEXTURE5);
         glBindTexture(GL_TEXTURE_2D, trice->materials[mesh.materialID].NormalMapID);
-        glBindVertexArray(mesh.vao);
-        shader->setBool("hasTexture", trice->materials[mesh.materialID].hasTexture);
-        shader->setBool("hasNormalMap", trice->materials[mesh.materialID].hasNormalMap && renderConfig.normal_mapping);
-        shader->setInt("textureMap", 0);
-        shader->setVec3("material.ambient", trice->materials[mesh.materialID].ambientColor);
-        shader->setVec3("material.diffuse", trice->materials[mesh.materialID].diffuseColor);
-        shader->setVec3("material.specular", trice->materials[mesh.materialID].specularColor);
-        shader->setFloat("material.shininess", trice->materials[mesh.materialID].shininess);
-        glDrawElements(GL_TRIANGLES, (GLint) mesh.indicesCount, GL_UNSIGNED_INT, (GLvoid *) nullptr);
+        bindVertexArray(mesh.vao);
+        setMaterial(shaderUniforms, trice->materials[mesh.materialID]);
+        shaderUniforms.hasNormalMap.set(trice->materials[mesh.materialID].hasNormalMap && renderConfig.normal_mapping);
+        drawMesh(trice, mesh, viewLod(mesh, trice_matrix), trice_matrix, cameraView);
     }
 
     if (renderConfig.Area_Light) {
         areaLightShader->use();
         
-        glBindVertexArray(areaLightVAO);
+        bindVertexArray(areaLightVAO);
         areaLightShader->setMat4("model", areaLightModel);
         areaLightShader->setMat4("view",camera->getViewMatrix());
         areaLightShader->setMat4("projection", projection_matrix);
@@ -835,17 +979,15 @@ void draw() {
         glClear(GL_STENCIL_BUFFER_BIT);
         glStencilFunc(GL_ALWAYS, 1, 0xFF);
         glStencilMask(0xFF);
-        shader->setMat4("model", glm::scale(glm::translate(glm::mat4(1.0), emissive_sphere_position), glm::vec3(0.22)));
+        shader->setMat4("model", emissive_sphere_matrix);
         shader->setBool("isLightObject", true);
+        setVertexFormat(shaderUniforms, emissive_sphere);
         for (auto& mesh : emissive_sphere->meshes) {
-            glBindVertexArray(mesh.vao);
-            shader->setBool("hasTexture", emissive_sphere->materials[mesh.materialID].hasTexture);
+            bindVertexArray(mesh.vao);
+            setMaterial(shaderUniforms, emissive_sphere->materials[mesh.materialID]);
             shader->setInt("textureMap", emissive_sphere->materials[mesh.materialID].textureID);
-            shader->setVec3("material.ambient", emissive_sphere->materials[mesh.materialID].ambientColor);
-            shader->setVec3("material.diffuse", glm::vec3(1.0));
-            shader->setVec3("material.specular", emissive_sphere->materials[mesh.materialID].specularColor);
-            shader->setFloat("material.shininess", emissive_sphere->materials[mesh.materialID].shininess);
-            glDrawElements(GL_TRIANGLES, (GLint)mesh.indicesCount, GL_UNSIGNED_INT, (GLvoid*) nullptr);
+            shaderUniforms.diffuse.set(glm::vec3(1.0));
+            drawMesh(emissive_sphere, mesh, viewLod(mesh, emissive_sphere_matrix), emissive_sphere_matrix, cameraView);
         }
 
         glBindFramebuffer(GL_DRAW_FRAMEBUFFER, BloomEffect_HDR_FBO);
@@ -854,17 +996,15 @@ void draw() {
         glStencilMask(0x00);
         glClearColor(0.0, 0.0, 0.0, 1.0);
         glClear(GL_COLOR_BUFFER_BIT);
-        shader->setMat4("model", glm::scale(glm::translate(glm::mat4(1.0), emissive_sphere_position), glm::vec3(0.22)));
+        shader->setMat4("model", emissive_sphere_matrix);
         shader->setBool("isLightObject", true);
+        setVertexFormat(shaderUniforms, emissive_sphere);
         for (auto& mesh : emissive_sphere->meshes) {
-            glBindVertexArray(mesh.vao);
-            shader->setBool("hasTexture", emissive_sphere->materials[mesh.materialID].hasTexture);
+            bindVertexArray(mesh.vao);
+            setMaterial(shaderUniforms, emissive_sphere->materials[mesh.materialID]);
             shader->setInt("textureMap", emissive_sphere->materials[mesh.materialID].textureID);
-            shader->setVec3("material.ambient", emissive_sphere->materials[mesh.materialID].ambientColor);
-            shader->setVec3("material.diffuse", glm::vec3(1.0));
-            shader->setVec3("material.specular", emissive_sphere->materials[mesh.materialID].specularColor);
-            shader->setFloat("material.shininess", emissive_sphere->materials[mesh.materialID].shininess);
-            glDrawElements(GL_TRIANGLES, (GLint)mesh.indicesCount, GL_UNSIGNED_INT, (GLvoid*) nullptr);
+            shaderUniforms.diffuse.set(glm::vec3(1.0));
+            drawMesh(emissive_sphere, mesh, viewLod(mesh, emissive_sphere_matrix), emissive_sphere_matrix, cameraView);
         }
         shader->setBool("isLightObject", false);
 
@@ -874,7 +1014,7 @@ void draw() {
         int BloomEffect_amount = 10;
         glViewport(0, 0, WIDTH, HEIGHT);
         BloomEffect_BlurShader->use();
-        glBindVertexArray(frameVAO);
+        bindVertexArray(frameVAO);
         for (unsigned int i = 0; i < BloomEffect_amount; i++) {
             glBindFramebuffer(GL_FRAMEBUFFER, BloomEffect_pingpongFBO[BloomEffect_horizontal]);
             glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
@@ -928,6 +1068,19 @@ void prepare_imgui() {
             ImGui::SliderInt("G Buffers", &renderConfig.gbuffer, 0, 4);
         }
         ImGui::Checkbox("Normal mapping", &renderConfig.normal_mapping);
+        ImGui::SliderFloat("LOD pixel error", &renderConfig.lod_pixel_error, 0.0f, 8.0f);
+        ImGui::SliderInt("Shadow LOD", &renderConfig.shadow_lod, 0, (int) Model::lodTargetCount);
+        ImGui::Checkbox("Cluster culling", &renderConfig.cluster_culling);
+        ImGui::Text("Clusters drawn: %u / %u", clustersVisible, clustersTotal);
+        ImGui::Text("Uniforms: %u sent, %u skipped", frameUniformStats.issued, frameUniformStats.skipped);
+        ImGui::Text("Shader variants: %zu compiled", textureShaders->size());
+        std::vector<TextureCache::Residency> residency = TextureCache::shared().residency();
+        if (ImGui::TreeNode("Texture memory", "Texture memory: %.1f MB in %zu textures",
+                            (double) TextureCache::shared().residentBytes() / (1024.0 * 1024.0), residency.size())) {
+            for (auto &texture: residency)
+                ImGui::Text("%8.1f KB  %s", (double) texture.bytes / 1024.0, texture.path.c_str());
+            ImGui::TreePop();
+        }
         /*----- Bloom Effect ImGui Begin -----*/
         ImGui::Checkbox("Bloom", &renderConfig.bloom);
         if (renderConfig.bloom) {
@@ -1167,7 +1320,8 @@ void framebuffer_size_callback(GLFWwindow *window, int width, int height) {
     /*----- Post Process RBO/Textures Resize End ----- */
 
     // Re-render the scene because the current frame was drawn for the old resolution
-    draw();
+    if (shadersReady())
+        draw();
     glfwSwapBuffers(window);
 }
 
@@ -1192,6 +1346,8 @@ static void GLAPIENTRY debugMessageCallback(GLenum source, GLenum type, GLuint i
 }
 
 int main(int argc, char *argv[]) {
+    // starts the startup clock
+    StartupProfiler &startupProfiler = StartupProfiler::shared();
     GLFWwindow *window;
 
     glfwSetErrorCallback(error_callback);
@@ -1274,13 +1430,20 @@ int main(int argc, char *argv[]) {
         deltaTime = currentFrame - lastFrame;
         lastFrame = currentFrame;
         process_input(window);
+        Model::updateStreaming(STREAMING_UPLOAD_BUDGET);
 
         prepare_imgui();
         // left click to lock screen for camera movement
         if (!io.WantCaptureMouse && ImGui::IsMouseClicked(0)) {
             mouse_button_callback(window);
         }
-        draw();
+        bool drawn = shadersReady();
+        if (drawn) {
+            draw();
+        } else {
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        }
         ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
 
         if (io.ConfigFlags & ImGuiConfigFlags_ViewportsEnable) {
@@ -1291,6 +1454,12 @@ int main(int argc, char *argv[]) {
         }
 
         glfwSwapBuffers(window);
+
+        if (drawn)
+            startupProfiler.markFirstFrame();
+        if (drawn && !startupProfiler.hasReported() && gray_room->isLoaded() && trice->isLoaded() &&
+            emissive_sphere->isLoaded())
+            startupProfiler.report("startup_profile.json");
     }
 
     glfwDestroyWindow(window);
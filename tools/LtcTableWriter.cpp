@@ -0,0 +1,62 @@
+// Writes assets/ltc_tables.bin from the float tables in src/Area_Light_LTC.h and checks that every value
+// survived the conversion to half float. Usage: ltc_table_writer [output] [--verify]
+// --verify only checks an existing blob.
+
+#include "../src/LtcTables.h"
+#include "../src/Area_Light_LTC.h"
+
+#include <cmath>
+#include <string>
+#include <iostream>
+#include <algorithm>
+
+#include "glm/gtc/packing.hpp"
+
+namespace {
+    static_assert(sizeof(LTC1) / sizeof(float) == LtcTables::tableLength, "LTC1 is 64x64 RGBA");
+    static_assert(sizeof(LTC2) / sizeof(float) == LtcTables::tableLength, "LTC2 is 64x64 RGBA");
+
+    // half keeps 11 significant bits, below the normal range the step is 2^-24
+    bool withinHalfTolerance(float expected, float actual) {
+        return std::abs(expected - actual) <= std::max(std::abs(expected) * 0.00049f, 5.97e-8f);
+    }
+}
+
+int main(int argc, char **argv) {
+    std::string path = "assets/ltc_tables.bin";
+    bool verifyOnly = false;
+    for (int i = 1; i < argc; i++) {
+        std::string argument = argv[i];
+        if (argument == "--verify")
+            verifyOnly = true;
+        else
+            path = argument;
+    }
+
+    const float *const tables[LtcTables::tableCount] = {LTC1, LTC2};
+    if (!verifyOnly && !LtcTables::write(path, tables)) {
+        std::cout << "Failed to write " << path << std::endl;
+        return 1;
+    }
+
+    LtcTables blob;
+    if (!blob.open(path)) {
+        std::cout << "Not a valid LTC table blob: " << path << std::endl;
+        return 1;
+    }
+    float largestError = 0.0f;
+    for (int table = 0; table < LtcTables::tableCount; table++) {
+        for (size_t i = 0; i < LtcTables::tableLength; i++) {
+            float expected = tables[table][i];
+            float actual = glm::unpackHalf1x16(blob.table(table)[i]);
+            largestError = std::max(largestError, std::abs(expected - actual));
+            if (!withinHalfTolerance(expected, actual)) {
+                std::cout << "LTC" << table + 1 << "[" << i << "] is " << actual << ", expected " << expected
+                          << std::endl;
+                return 1;
+            }
+        }
+    }
+    std::cout << path << " matches the float tables, largest absolute error " << largestError << std::endl;
+    return 0;
+}